@@ -155,6 +155,25 @@ void TransferFunctionWidget::draw_ui()
 
     draw_list->AddRect(canvas_pos, canvas_pos + canvas_size, ImColor(180, 180, 180, 255));
 
+    // Draw the histogram behind everything else, one bar per column of pixels
+    // which shows the tallest of the bins falling into it
+    if (!histogram.empty()) {
+        const size_t column_count = std::max((size_t)canvas_size.x, size_t(1));
+        for (size_t c = 0; c < column_count; ++c) {
+            const size_t begin = c * histogram.size() / column_count;
+            const size_t end = std::max((c + 1) * histogram.size() / column_count, begin + 1);
+            float height = 0.f;
+            for (size_t i = begin; i < end; ++i) {
+                height = std::max(height, histogram[i]);
+            }
+            if (height > 0.f) {
+                const vec2f bar_min(canvas_pos.x + c, view_offset.y - height * canvas_size.y);
+                const vec2f bar_max(canvas_pos.x + c + 1, view_offset.y);
+                draw_list->AddRectFilled(bar_min, bar_max, ImColor(120, 120, 120, 140));
+            }
+        }
+    }
+
     ImGui::InvisibleButton("tfn_canvas", canvas_size);
 
     static bool clicked_on_item = false;
@@ -253,6 +272,11 @@ void TransferFunctionWidget::draw_ui()
     draw_list->PopClipRect();
 }
 
+void TransferFunctionWidget::set_histogram(const std::vector<float>& heights)
+{
+    histogram = heights;
+}
+
 bool TransferFunctionWidget::changed() const
 {
     return colormap_changed;
@@ -49,6 +49,9 @@ class TransferFunctionWidget
     std::vector<vec2f> alpha_control_pts = { vec2f(0.f), vec2f(1.f) };
     size_t selected_point = -1;
 
+    // Bar heights in [0, 1], spread evenly over the domain of the transfer function
+    std::vector<float> histogram;
+
     bool clicked_on_item = false;
     bool gpu_image_stale = true;
     bool colormap_changed = true;
@@ -64,6 +67,10 @@ public:
     // Add the transfer function UI into the currently active window
     void draw_ui();
 
+    // Set the histogram drawn behind the alpha control points, bar heights are
+    // in [0, 1] and spread evenly over the domain. Empty to draw none.
+    void set_histogram(const std::vector<float>& heights);
+
     // Returns true if the colormap was updated since the last
     // call to draw_ui
     bool changed() const;
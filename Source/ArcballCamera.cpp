@@ -30,6 +30,14 @@ void ArcballCamera::Rotate(const glm::vec2& prev_mouse, const glm::vec2& curr_mo
 #endif
 }
 
+void ArcballCamera::SetViewportSize(float w, float h)
+{
+    width = w;
+    height = h;
+
+    projection = glm::perspective(fov, (float)width / (float)height, z_near, z_far);
+}
+
 void ArcballCamera::SetFOV(int value)
 {
     float strength = 0.05f;
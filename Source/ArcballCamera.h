@@ -14,6 +14,9 @@ struct ArcballCamera
     void Rotate(const glm::vec2& prev_mouse, const glm::vec2& curr_mouse);
     void SetFOV(int value);
 
+    // Note: Call whenever the framebuffer is resized, both the aspect ratio and the arcball depend on it
+    void SetViewportSize(float w, float h);
+
     glm::mat4 view;
     glm::mat4 projection;
     float fov;
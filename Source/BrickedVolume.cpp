@@ -0,0 +1,311 @@
+#include "BrickedVolume.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "LZ.h"
+#include "Core/Win32.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+bool BrickedVolume::Open(const unsigned char* data, size_t size)
+{
+    if (size < sizeof(BrickedVolumeHeader))
+        return false;
+
+    const BrickedVolumeHeader* header = (const BrickedVolumeHeader*)data;
+    if (header->magic != BRICKED_VOLUME_MAGIC || (header->version != 1 && header->version != BRICKED_VOLUME_VERSION))
+        return false;
+
+    version = header->version;
+    desc.dimensions = glm::ivec3(header->dimensions[0], header->dimensions[1], header->dimensions[2]);
+    desc.spacing = glm::vec3(header->spacing[0], header->spacing[1], header->spacing[2]);
+    brick_size = (int)header->brick_size;
+
+    if (version == 1)
+    {
+        const uint32_t byte_count = (uint32_t)header->data_type;
+        if (byte_count != 1 && byte_count != 2)
+            return false;
+        desc.data_type = (byte_count == 1) ? VolumeDataType::UINT8 : VolumeDataType::UINT16;
+    }
+    else
+    {
+        desc.data_type = header->data_type;
+        if (desc.GetByteCount() == 0)
+            return false;
+    }
+
+    if (glm::any(glm::lessThanEqual(desc.dimensions, glm::ivec3(0))) || brick_size <= 0)
+        return false;
+
+    brick_count = (desc.dimensions + brick_size - 1) / brick_size;
+
+    const size_t index_end = sizeof(BrickedVolumeHeader) + GetBrickCount() * sizeof(BrickInfo);
+    if (size < index_end)
+        return false;
+
+    bricks = (const BrickInfo*)(data + sizeof(BrickedVolumeHeader));
+    for (size_t i = 0; i < GetBrickCount(); ++i)
+    {
+        if (bricks[i].encoding != BrickEncoding::CONSTANT && bricks[i].offset + bricks[i].compressed_size > size)
+            return false;
+    }
+
+    file_data = data;
+    file_size = size;
+
+    return true;
+}
+
+glm::ivec3 BrickedVolume::GetBrickOrigin(size_t index) const
+{
+    glm::ivec3 brick((int)(index % brick_count.x), (int)((index / brick_count.x) % brick_count.y), (int)(index / ((size_t)brick_count.x * brick_count.y)));
+    return brick * brick_size;
+}
+
+glm::ivec3 BrickedVolume::GetBrickExtent(size_t index) const
+{
+    return glm::min(glm::ivec3(brick_size), desc.dimensions - GetBrickOrigin(index));
+}
+
+bool BrickedVolume::ReadBrick(size_t index, unsigned char* dst) const
+{
+    const BrickInfo& brick = bricks[index];
+    const glm::ivec3 extent = GetBrickExtent(index);
+    const size_t voxel_count = (size_t)extent.x * extent.y * extent.z;
+    const unsigned int byte_count = desc.GetByteCount();
+    const size_t brick_bytes = voxel_count * byte_count;
+
+    switch (brick.encoding)
+    {
+        case BrickEncoding::CONSTANT:
+        {
+            uint64_t value = brick.offset;
+            if (version == 1)
+                value = (uint64_t)brick.min;
+
+            if (byte_count == 1)
+            {
+                memset(dst, (int)value, brick_bytes);
+            }
+            else
+            {
+                for (size_t i = 0; i < voxel_count; ++i)
+                    memcpy(dst + i * byte_count, &value, byte_count);
+            }
+            return true;
+        }
+
+        case BrickEncoding::LZ:
+            return LZDecompress(file_data + brick.offset, brick.compressed_size, dst, brick_bytes);
+
+        case BrickEncoding::STORED:
+        {
+            if (brick.compressed_size != brick_bytes)
+                return false;
+            memcpy(dst, file_data + brick.offset, brick_bytes);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool BrickedVolume::ReadRegion(const glm::ivec3& begin, const glm::ivec3& end, unsigned char* dst) const
+{
+    const glm::ivec3 region = end - begin;
+    const glm::ivec3 first_brick = begin / brick_size;
+    const glm::ivec3 last_brick = (end - 1) / brick_size;
+    const glm::ivec3 region_brick_count = last_brick - first_brick + 1;
+
+    const unsigned int byte_count = desc.GetByteCount();
+    const size_t brick_bytes = (size_t)brick_size * brick_size * brick_size * byte_count;
+    std::atomic<bool> success = true;
+
+    ThreadPool::Get().ParallelFor((size_t)region_brick_count.x * region_brick_count.y * region_brick_count.z, [&](size_t i)
+    {
+        glm::ivec3 brick = first_brick + glm::ivec3((int)(i % region_brick_count.x),
+            (int)((i / region_brick_count.x) % region_brick_count.y), (int)(i / ((size_t)region_brick_count.x * region_brick_count.y)));
+        const size_t index = ((size_t)brick.z * brick_count.y + brick.y) * brick_count.x + brick.x;
+
+        thread_local std::vector<unsigned char> scratch;
+        scratch.resize(brick_bytes);
+        if (!ReadBrick(index, scratch.data()))
+        {
+            success = false;
+            return;
+        }
+
+        // Copy over the rows of the brick which overlap the region
+        const glm::ivec3 origin = GetBrickOrigin(index);
+        const glm::ivec3 extent = GetBrickExtent(index);
+        const glm::ivec3 overlap_begin = glm::max(origin, begin);
+        const glm::ivec3 overlap_end = glm::min(origin + extent, end);
+        const size_t row_bytes = (size_t)(overlap_end.x - overlap_begin.x) * byte_count;
+
+        for (int z = overlap_begin.z; z < overlap_end.z; ++z)
+        {
+            for (int y = overlap_begin.y; y < overlap_end.y; ++y)
+            {
+                const size_t src_index = ((size_t)(z - origin.z) * extent.y + (y - origin.y)) * extent.x + (overlap_begin.x - origin.x);
+                const size_t dst_index = ((size_t)(z - begin.z) * region.y + (y - begin.y)) * region.x + (overlap_begin.x - begin.x);
+                memcpy(dst + dst_index * byte_count, scratch.data() + src_index * byte_count, row_bytes);
+            }
+        }
+    });
+
+    return success;
+}
+
+bool IsBrickedVolumeFile(const std::string& path)
+{
+    return std::filesystem::path(path).extension() == ".bvol";
+}
+
+bool ConvertToBrickedVolume(const VolumeDesc& desc, const std::string& out_path, int brick_size)
+{
+    auto begin = std::chrono::high_resolution_clock::now();
+
+    MappedFile file(desc.path.c_str());
+    const unsigned char* voxels = FindVoxelData(file, desc);
+    if (!voxels)
+        return false;
+
+    std::ofstream out(out_path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+        std::ostringstream oss;
+        oss << "Unable to open file for writing at path: " << out_path << std::endl;
+        OutputDebugStringA(oss.str().c_str());
+        return false;
+    }
+
+    BrickedVolume layout;
+    layout.desc = desc;
+    layout.brick_size = brick_size;
+    layout.brick_count = (desc.dimensions + brick_size - 1) / brick_size;
+    const unsigned int byte_count = desc.GetByteCount();
+
+    BrickedVolumeHeader header = {};
+    header.magic = BRICKED_VOLUME_MAGIC;
+    header.version = BRICKED_VOLUME_VERSION;
+    for (int i = 0; i < 3; ++i)
+    {
+        header.dimensions[i] = desc.dimensions[i];
+        header.spacing[i] = desc.spacing[i];
+    }
+    header.data_type = desc.data_type;
+    header.brick_size = brick_size;
+
+    // Note: The index is written last, once we know where every brick ended up
+    std::vector<BrickInfo> bricks(layout.GetBrickCount());
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)bricks.data(), bricks.size() * sizeof(BrickInfo));
+    uint64_t offset = sizeof(header) + bricks.size() * sizeof(BrickInfo);
+
+    // Compress one layer of bricks at a time, so we never hold more than a layer of compressed data in memory
+    const size_t layer_brick_count = (size_t)layout.brick_count.x * layout.brick_count.y;
+    std::vector<std::vector<unsigned char>> compressed(layer_brick_count);
+
+    for (int layer = 0; layer < layout.brick_count.z; ++layer)
+    {
+        ThreadPool::Get().ParallelFor(layer_brick_count, [&](size_t i)
+        {
+            const size_t index = layer * layer_brick_count + i;
+            const glm::ivec3 origin = layout.GetBrickOrigin(index);
+            const glm::ivec3 extent = layout.GetBrickExtent(index);
+            const size_t row_bytes = (size_t)extent.x * byte_count;
+            const size_t brick_bytes = row_bytes * extent.y * extent.z;
+
+            // Gather the brick from the volume, converting to little endian on the way
+            thread_local std::vector<unsigned char> gathered;
+            gathered.resize(brick_bytes);
+            for (int z = 0; z < extent.z; ++z)
+            {
+                for (int y = 0; y < extent.y; ++y)
+                {
+                    const size_t src_index = ((size_t)(origin.z + z) * desc.dimensions.y + (origin.y + y)) * desc.dimensions.x + origin.x;
+                    unsigned char* dst = gathered.data() + ((size_t)z * extent.y + y) * row_bytes;
+                    memcpy(dst, voxels + src_index * byte_count, row_bytes);
+
+                    if (desc.big_endian)
+                        SwapBytes(dst, row_bytes, byte_count);
+                }
+            }
+
+            // Note: Constant is decided on the bits, not the values, floats can't tell apart large 32 bit integers
+            BrickInfo& brick = bricks[index];
+            const glm::vec2 range = FindValueRange(gathered.data(), brick_bytes / byte_count, desc.data_type);
+            brick.min = (range.x <= range.y) ? range.x : 0.f;
+            brick.max = (range.x <= range.y) ? range.y : 0.f;
+
+            bool constant = true;
+            for (size_t k = byte_count; k < brick_bytes && constant; k += byte_count)
+                constant = memcmp(gathered.data(), gathered.data() + k, byte_count) == 0;
+
+            std::vector<unsigned char>& data = compressed[i];
+            if (constant)
+            {
+                brick.encoding = BrickEncoding::CONSTANT;
+                brick.offset = 0;
+                memcpy(&brick.offset, gathered.data(), byte_count);
+                data.clear();
+                return;
+            }
+
+            data.resize(LZCompressBound(brick_bytes));
+            size_t compressed_size = LZCompress(gathered.data(), brick_bytes, data.data(), data.size());
+            if (compressed_size == 0 || compressed_size >= brick_bytes)
+            {
+                brick.encoding = BrickEncoding::STORED;
+                data.assign(gathered.begin(), gathered.end());
+            }
+            else
+            {
+                brick.encoding = BrickEncoding::LZ;
+                data.resize(compressed_size);
+            }
+        });
+
+        for (size_t i = 0; i < layer_brick_count; ++i)
+        {
+            BrickInfo& brick = bricks[layer * layer_brick_count + i];
+            if (brick.encoding == BrickEncoding::CONSTANT)
+                continue;
+
+            brick.offset = offset;
+            brick.compressed_size = (uint32_t)compressed[i].size();
+
+            out.write((const char*)compressed[i].data(), compressed[i].size());
+            offset += compressed[i].size();
+        }
+    }
+
+    out.seekp(sizeof(header));
+    out.write((const char*)bricks.data(), bricks.size() * sizeof(BrickInfo));
+    out.close();
+
+    if (!out)
+    {
+        std::ostringstream oss;
+        oss << "Failed writing bricked volume at path: " << out_path << std::endl;
+        OutputDebugStringA(oss.str().c_str());
+        return false;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - begin;
+    const size_t volume_size = desc.GetSize();
+
+    std::ostringstream oss;
+    oss << "Converted " << desc.path << " to " << out_path << ": " << volume_size << " -> " << offset << " bytes ("
+        << (double)volume_size / (double)offset << ":1) in " << elapsed.count() * 1000.0 << " ms" << std::endl;
+    OutputDebugStringA(oss.str().c_str());
+
+    return true;
+}
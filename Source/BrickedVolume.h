@@ -0,0 +1,91 @@
+#ifndef BRICKED_VOLUME_H
+
+#include "Volume.h"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+
+// Native container for volumes (.bvol). The volume is split up into fixed size bricks (edge bricks are clipped to
+// the volume), each of them compressed independently with the LZ codec, so that bricks can be decompressed in
+// parallel and any region of the volume can be read without touching the rest of the file.
+//
+// Layout:
+//  -> BrickedVolumeHeader
+//  -> BrickInfo for every brick, bricks are in X-major order
+//  -> Compressed brick data, every brick stores its voxels in X-major order
+//
+// Constant bricks (which is what empty space usually is) don't store any data at all, their value is in the index.
+//
+// Version 1 only had 8 and 16 bit unsigned volumes, its header stores the byte count instead of the data type and
+// constant bricks store their value as the (float) min only.
+
+#define BRICKED_VOLUME_MAGIC 0x4C4F5642 // "BVOL"
+#define BRICKED_VOLUME_VERSION 2
+
+struct BrickedVolumeHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    int32_t dimensions[3];
+    float spacing[3];
+    VolumeDataType data_type;
+    uint32_t brick_size;
+};
+
+enum class BrickEncoding : uint32_t
+{
+    CONSTANT,
+    LZ,
+    STORED
+};
+
+struct BrickInfo
+{
+    // Note: For CONSTANT bricks this is the bit pattern of the (little endian) voxel instead
+    uint64_t offset;
+    uint32_t compressed_size;
+    BrickEncoding encoding;
+    float min;
+    float max;
+};
+
+static_assert(sizeof(BrickedVolumeHeader) == 40, "BrickedVolumeHeader is written to disk as is");
+static_assert(sizeof(BrickInfo) == 24, "BrickInfo is written to disk as is");
+
+// Read access to a (mapped) .bvol file
+struct BrickedVolume
+{
+    // Returns false if the data isn't a valid .bvol file, `data` has to outlive the BrickedVolume
+    bool Open(const unsigned char* data, size_t size);
+
+    // Decompresses the voxels of the region [begin, end) into `dst`, which is tightly packed in X-major order.
+    // Only the bricks overlapping the region are touched and they are decompressed in parallel.
+    bool ReadRegion(const glm::ivec3& begin, const glm::ivec3& end, unsigned char* dst) const;
+
+    // Decompresses a single brick into `dst`, tightly packed with the (clipped) extent of the brick
+    bool ReadBrick(size_t index, unsigned char* dst) const;
+
+    glm::ivec3 GetBrickOrigin(size_t index) const;
+    glm::ivec3 GetBrickExtent(size_t index) const;
+    inline size_t GetBrickCount() const { return (size_t)brick_count.x * brick_count.y * brick_count.z; }
+
+    VolumeDesc desc;
+    int brick_size = 0;
+    glm::ivec3 brick_count = glm::ivec3(0);
+    const BrickInfo* bricks = nullptr;
+
+private:
+    uint32_t version = BRICKED_VOLUME_VERSION;
+    const unsigned char* file_data = nullptr;
+    size_t file_size = 0;
+};
+
+bool IsBrickedVolumeFile(const std::string& path);
+
+// Converts the volume described by `desc` (raw, or anything the VolumeHeader readers understand) into a .bvol file.
+// Bricks are compressed in parallel, the source is memory mapped.
+bool ConvertToBrickedVolume(const VolumeDesc& desc, const std::string& out_path, int brick_size = 64);
+
+#define BRICKED_VOLUME_H
+#endif
@@ -0,0 +1,205 @@
+#include "CompressedVolume.h"
+#include "ThreadPool.h"
+#include "Core/Win32.h"
+
+#include <stb_image/stb_image.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+
+#define GZIP_FLAG_HCRC 0x02
+#define GZIP_FLAG_EXTRA 0x04
+#define GZIP_FLAG_NAME 0x08
+#define GZIP_FLAG_COMMENT 0x10
+#define GZIP_TRAILER_SIZE 8
+
+static unsigned int Read16(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static unsigned int Read32(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+// Returns the size of the gzip member header at `data`, 0 if it isn't one. `member_size` is the total size of the
+// member if the header carries a BGZF block size, 0 otherwise.
+static size_t ParseGzipHeader(const unsigned char* data, size_t size, size_t& member_size)
+{
+    member_size = 0;
+    if (size < 10 || data[0] != 0x1F || data[1] != 0x8B || data[2] != 8)
+        return 0;
+
+    const unsigned char flags = data[3];
+    size_t pos = 10;
+
+    if (flags & GZIP_FLAG_EXTRA)
+    {
+        if (pos + 2 > size)
+            return 0;
+        const size_t extra_end = pos + 2 + Read16(data + pos);
+        pos += 2;
+        if (extra_end > size)
+            return 0;
+
+        // Subfields are SI1 SI2 LEN(2) followed by LEN bytes, BGZF's is 'B' 'C' with the member size minus one
+        while (pos + 4 <= extra_end)
+        {
+            const unsigned int subfield_size = Read16(data + pos + 2);
+            if (data[pos] == 'B' && data[pos + 1] == 'C' && subfield_size == 2 && pos + 6 <= extra_end)
+                member_size = Read16(data + pos + 4) + 1;
+            pos += 4 + subfield_size;
+        }
+        pos = extra_end;
+    }
+
+    for (unsigned char flag : { GZIP_FLAG_NAME, GZIP_FLAG_COMMENT })
+    {
+        if (flags & flag)
+        {
+            while (pos < size && data[pos] != 0)
+                ++pos;
+            ++pos;
+        }
+    }
+
+    if (flags & GZIP_FLAG_HCRC)
+        pos += 2;
+
+    return (pos < size) ? pos : 0;
+}
+
+static bool CompressedVolumeError(const VolumeDesc& desc, const char* message)
+{
+    std::ostringstream oss;
+    oss << "Unable to inflate volume at path: " << desc.path << ", " << message << std::endl;
+    OutputDebugStringA(oss.str().c_str());
+    return false;
+}
+
+bool CompressedVolume::IndexMembers(const unsigned char* data, size_t size)
+{
+    size_t pos = 0;
+    size_t offset = 0;
+    while (pos < size)
+    {
+        size_t member_size;
+        const size_t header_size = ParseGzipHeader(data + pos, size - pos, member_size);
+        if (header_size == 0 || member_size < header_size + GZIP_TRAILER_SIZE || pos + member_size > size)
+        {
+            members.clear();
+            return false;
+        }
+
+        // Note: ISIZE is the uncompressed size modulo 2^32, BGZF members are never larger than 64 KB
+        Member member;
+        member.compressed_offset = pos + header_size;
+        member.compressed_size = member_size - header_size - GZIP_TRAILER_SIZE;
+        member.offset = offset;
+        member.size = Read32(data + pos + member_size - 4);
+
+        if (member.size > 0)
+            members.push_back(member);
+
+        offset += member.size;
+        pos += member_size;
+    }
+
+    return !members.empty();
+}
+
+bool CompressedVolume::Open(const unsigned char* data, size_t size, const VolumeDesc& desc)
+{
+    compressed_data = data;
+    const size_t expected_size = desc.GetSize();
+
+    if (desc.encoding == VolumeEncoding::GZIP && IndexMembers(data, size))
+    {
+        if (members.back().offset + members.back().size != expected_size)
+        {
+            members.clear();
+            return CompressedVolumeError(desc, "uncompressed size doesn't match the dimensions");
+        }
+        return true;
+    }
+
+    if (expected_size >= (size_t)INT_MAX || size >= (size_t)INT_MAX)
+        return CompressedVolumeError(desc, "a single deflate stream has to be smaller than 2 GB, recompress it with bgzip");
+
+    inflated.resize(expected_size);
+
+    int inflated_size = -1;
+    if (desc.encoding == VolumeEncoding::GZIP)
+    {
+        size_t member_size;
+        const size_t header_size = ParseGzipHeader(data, size, member_size);
+        if (header_size == 0)
+            return CompressedVolumeError(desc, "not a gzip stream");
+
+        inflated_size = stbi_zlib_decode_noheader_buffer((char*)inflated.data(), (int)expected_size, (const char*)data + header_size, (int)(size - header_size));
+    }
+    else
+    {
+        inflated_size = stbi_zlib_decode_buffer((char*)inflated.data(), (int)expected_size, (const char*)data, (int)size);
+    }
+
+    // Note: Only the first member of a gzip file is inflated here, so a multi-member file without block sizes ends
+    // up short as well
+    if (inflated_size != (int)expected_size)
+    {
+        inflated.clear();
+        return CompressedVolumeError(desc, "corrupt stream, or its uncompressed size doesn't match the dimensions");
+    }
+
+    return true;
+}
+
+bool CompressedVolume::ReadRange(size_t begin, size_t end, unsigned char* dst) const
+{
+    if (!IsChunked())
+    {
+        memcpy(dst, inflated.data() + begin, end - begin);
+        return true;
+    }
+
+    auto first = std::upper_bound(members.begin(), members.end(), begin, [](size_t offset, const Member& member) { return offset < member.offset + member.size; });
+    auto last = std::lower_bound(first, members.end(), end, [](const Member& member, size_t offset) { return member.offset < offset; });
+
+    std::atomic<bool> success = true;
+    ThreadPool::Get().ParallelFor(last - first, [&](size_t i)
+    {
+        const Member& member = *(first + i);
+        const char* src = (const char*)compressed_data + member.compressed_offset;
+
+        // Members entirely within the range are inflated in place, the ones straddling its ends through a scratch buffer
+        if (member.offset >= begin && member.offset + member.size <= end)
+        {
+            if (stbi_zlib_decode_noheader_buffer((char*)dst + (member.offset - begin), (int)member.size, src, (int)member.compressed_size) != (int)member.size)
+                success = false;
+        }
+        else
+        {
+            thread_local std::vector<unsigned char> scratch;
+            scratch.resize(member.size);
+            if (stbi_zlib_decode_noheader_buffer((char*)scratch.data(), (int)member.size, src, (int)member.compressed_size) != (int)member.size)
+            {
+                success = false;
+                return;
+            }
+
+            const size_t overlap_begin = std::max(begin, member.offset);
+            const size_t overlap_end = std::min(end, member.offset + member.size);
+            memcpy(dst + (overlap_begin - begin), scratch.data() + (overlap_begin - member.offset), overlap_end - overlap_begin);
+        }
+    });
+
+    return success;
+}
+
+bool IsGzipFile(const std::string& path)
+{
+    return std::filesystem::path(path).extension() == ".gz";
+}
@@ -0,0 +1,45 @@
+#ifndef COMPRESSED_VOLUME_H
+
+#include "Volume.h"
+
+#include <vector>
+
+// A compressed stream of voxels, inflated with the zlib decoder bundled in stb_image.
+//
+// gzip files made up of independently compressed members which record their compressed size (BGZF, as written by
+// bgzip) are inflated member by member in parallel, straight into the destination. Anything else is a single
+// deflate stream which can only be inflated front to back, so it is inflated once up front.
+//
+// Note: stb_image's decoder works with int sizes, so a single deflate stream can't inflate to 2 GB or more, use
+// bgzip for anything larger.
+struct CompressedVolume
+{
+    // Returns false if the data isn't a valid stream of the encoding in `desc`, or doesn't hold exactly as many
+    // bytes as the volume needs
+    bool Open(const unsigned char* data, size_t size, const VolumeDesc& desc);
+
+    // Inflates the bytes [begin, end) of the uncompressed voxel data into `dst`
+    bool ReadRange(size_t begin, size_t end, unsigned char* dst) const;
+
+    inline bool IsChunked() const { return !members.empty(); }
+
+private:
+    struct Member
+    {
+        size_t compressed_offset;
+        size_t compressed_size;
+        size_t offset;
+        size_t size;
+    };
+
+    bool IndexMembers(const unsigned char* data, size_t size);
+
+    const unsigned char* compressed_data = nullptr;
+    std::vector<Member> members;
+    std::vector<unsigned char> inflated;
+};
+
+bool IsGzipFile(const std::string& path);
+
+#define COMPRESSED_VOLUME_H
+#endif
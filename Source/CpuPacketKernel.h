@@ -0,0 +1,208 @@
+// The packet ray marching kernel, written once against a packet type P and instantiated for every instruction set by
+// the CpuPacketKernel*.cpp files.
+//
+// Note: Only include this after the instruction set has been selected for the rest of the file (and after every other
+// header), the functions here are compiled for it. They live in an unnamed namespace so the copies compiled for
+// different instruction sets never get merged by the linker.
+//
+// P has to provide:
+//  -> WIDTH and the types Float (WIDTH floats) and Int (WIDTH 32 bit integers)
+//  -> Set, Load, Store, Add, Sub, Mul, Div, Min, Max, Floor
+//  -> Less (a mask), And, Select (mask ? a : b), Any (of a mask)
+//  -> SetInt, AddInt, MulInt, AndInt, OrInt, SubInt, ShiftRight<N> (logical), ShiftLeft<N>, ToInt (truncating), ToFloat,
+//     AsInt, AsFloat (bit casts)
+//  -> Gather (base[index] for every lane)
+
+#include "CpuPacketKernels.h"
+
+namespace
+{
+    // log2(x) for x in (0, 1], 0 maps to -127
+    template <typename P>
+    typename P::Float Log2(typename P::Float x)
+    {
+        typedef typename P::Float Float;
+        typedef typename P::Int Int;
+
+        // x = m * 2^e with the mantissa m in [sqrt(0.5), sqrt(2)), where the series below converges fast
+        const Int bits = P::AsInt(x);
+        Float e = P::ToFloat(P::SubInt(P::template ShiftRight<23>(bits), P::SetInt(127)));
+        Float m = P::AsFloat(P::OrInt(P::AndInt(bits, P::SetInt(0x007FFFFF)), P::SetInt(0x3F800000)));
+
+        const Float above = P::Less(P::Set(1.41421356f), m);
+        m = P::Select(above, P::Mul(m, P::Set(0.5f)), m);
+        e = P::Select(above, P::Add(e, P::Set(1.f)), e);
+
+        // log2(m) = 2 / ln(2) * (t + t^3 / 3 + t^5 / 5 + t^7 / 7 + ..) with t = (m - 1) / (m + 1)
+        const Float t = P::Div(P::Sub(m, P::Set(1.f)), P::Add(m, P::Set(1.f)));
+        const Float t2 = P::Mul(t, t);
+        Float series = P::Add(P::Set(1.f / 5.f), P::Mul(t2, P::Set(1.f / 7.f)));
+        series = P::Add(P::Set(1.f / 3.f), P::Mul(t2, series));
+        series = P::Add(P::Set(1.f), P::Mul(t2, series));
+
+        return P::Add(e, P::Mul(P::Set(2.88539008f), P::Mul(t, series)));
+    }
+
+    // 2^x for x <= 0, anything below -126 comes out as 2^-126
+    template <typename P>
+    typename P::Float Exp2(typename P::Float x)
+    {
+        typedef typename P::Float Float;
+
+        // 2^x = 2^n * e^(f * ln(2)) with n the integer nearest to x and f in [-0.5, 0.5]
+        x = P::Max(x, P::Set(-126.f));
+        const Float n = P::Floor(P::Add(x, P::Set(0.5f)));
+        const Float f = P::Mul(P::Sub(x, n), P::Set(0.693147181f));
+
+        Float series = P::Add(P::Set(1.f / 120.f), P::Mul(f, P::Set(1.f / 720.f)));
+        series = P::Add(P::Set(1.f / 24.f), P::Mul(f, series));
+        series = P::Add(P::Set(1.f / 6.f), P::Mul(f, series));
+        series = P::Add(P::Set(1.f / 2.f), P::Mul(f, series));
+        series = P::Add(P::Set(1.f), P::Mul(f, series));
+        series = P::Add(P::Set(1.f), P::Mul(f, series));
+
+        const Float scale = P::AsFloat(P::template ShiftLeft<23>(P::AddInt(P::ToInt(n), P::SetInt(127))));
+        return P::Mul(series, scale);
+    }
+
+    // Offset of the voxels at `coordinate` (a whole number within the volume) along AXIS, see MortonVolume::GetOffset
+    template <typename P, int AXIS>
+    typename P::Int GetAxisOffset(typename P::Float coordinate, typename P::Int brick_stride)
+    {
+        typedef typename P::Int Int;
+
+        const Int c = P::ToInt(coordinate);
+        const Int spread = P::OrInt(P::OrInt(P::AndInt(c, P::SetInt(1)), P::template ShiftLeft<2>(P::AndInt(c, P::SetInt(2)))),
+            P::template ShiftLeft<4>(P::AndInt(c, P::SetInt(4))));
+        const Int brick = P::template ShiftRight<MORTON_BRICK_BITS>(c);
+
+        // Note: Bricks follow each other along X, a shift does for the multiply there
+        const Int brick_offset = (AXIS == 0) ? P::template ShiftLeft<3 * MORTON_BRICK_BITS>(brick) : P::MulInt(brick, brick_stride);
+        return P::AddInt(brick_offset, P::template ShiftLeft<AXIS>(spread));
+    }
+
+    template <typename P>
+    typename P::Float SampleVolume(const CpuVolumeView& volume, const typename P::Float position[3])
+    {
+        typedef typename P::Float Float;
+        typedef typename P::Int Int;
+
+        // Voxel centres at (i + 0.5) / dimensions, clamped to the edge
+        Float p0[3], p1[3], f[3];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const Float max_texel = P::Set((float)(volume.dimensions[axis] - 1));
+            const Float texel_position = P::Sub(P::Mul(position[axis], P::Set((float)volume.dimensions[axis])), P::Set(0.5f));
+            const Float base = P::Floor(texel_position);
+            f[axis] = P::Sub(texel_position, base);
+            p0[axis] = P::Min(P::Max(base, P::Set(0.f)), max_texel);
+            p1[axis] = P::Min(P::Max(P::Add(base, P::Set(1.f)), P::Set(0.f)), max_texel);
+        }
+
+        const Int x0 = GetAxisOffset<P, 0>(p0[0], P::SetInt(volume.brick_strides[0]));
+        const Int x1 = GetAxisOffset<P, 0>(p1[0], P::SetInt(volume.brick_strides[0]));
+        const Int y0 = GetAxisOffset<P, 1>(p0[1], P::SetInt(volume.brick_strides[1]));
+        const Int y1 = GetAxisOffset<P, 1>(p1[1], P::SetInt(volume.brick_strides[1]));
+        const Int z0 = GetAxisOffset<P, 2>(p0[2], P::SetInt(volume.brick_strides[2]));
+        const Int z1 = GetAxisOffset<P, 2>(p1[2], P::SetInt(volume.brick_strides[2]));
+        const Int y0z0 = P::AddInt(y0, z0), y1z0 = P::AddInt(y1, z0), y0z1 = P::AddInt(y0, z1), y1z1 = P::AddInt(y1, z1);
+        const float* values = volume.values;
+
+        const Float c000 = P::Gather(values, P::AddInt(x0, y0z0));
+        const Float c100 = P::Gather(values, P::AddInt(x1, y0z0));
+        const Float c010 = P::Gather(values, P::AddInt(x0, y1z0));
+        const Float c110 = P::Gather(values, P::AddInt(x1, y1z0));
+        const Float c001 = P::Gather(values, P::AddInt(x0, y0z1));
+        const Float c101 = P::Gather(values, P::AddInt(x1, y0z1));
+        const Float c011 = P::Gather(values, P::AddInt(x0, y1z1));
+        const Float c111 = P::Gather(values, P::AddInt(x1, y1z1));
+
+        const Float c00 = P::Add(c000, P::Mul(P::Sub(c100, c000), f[0]));
+        const Float c10 = P::Add(c010, P::Mul(P::Sub(c110, c010), f[0]));
+        const Float c01 = P::Add(c001, P::Mul(P::Sub(c101, c001), f[0]));
+        const Float c11 = P::Add(c011, P::Mul(P::Sub(c111, c011), f[0]));
+
+        const Float c0 = P::Add(c00, P::Mul(P::Sub(c10, c00), f[1]));
+        const Float c1 = P::Add(c01, P::Mul(P::Sub(c11, c01), f[1]));
+        const Float value = P::Add(c0, P::Mul(P::Sub(c1, c0), f[2]));
+        return P::Min(P::Max(value, P::Set(0.f)), P::Set(1.f));
+    }
+
+    template <typename P>
+    void SampleTransferFunction(const CpuVolumeView& volume, typename P::Float value, typename P::Float color[4])
+    {
+        typedef typename P::Float Float;
+        typedef typename P::Int Int;
+
+        // Linear filtering, texel centres at (i + 0.5) / size and clamped to the edge
+        const Float max_texel = P::Set((float)(volume.transfer_function_size - 1));
+        const Float position = P::Sub(P::Mul(value, P::Set((float)volume.transfer_function_size)), P::Set(0.5f));
+        const Float base = P::Floor(position);
+        const Float f = P::Sub(position, base);
+        const Int i0 = P::ToInt(P::Min(P::Max(base, P::Set(0.f)), max_texel));
+        const Int i1 = P::ToInt(P::Min(P::Max(P::Add(base, P::Set(1.f)), P::Set(0.f)), max_texel));
+
+        for (int channel = 0; channel < 4; ++channel)
+        {
+            const Float c0 = P::Gather(volume.transfer_function[channel], i0);
+            const Float c1 = P::Gather(volume.transfer_function[channel], i1);
+            color[channel] = P::Add(c0, P::Mul(P::Sub(c1, c0), f));
+        }
+    }
+
+    // Marches the P::WIDTH rays starting at `first` together, every one of them until it leaves the volume or its
+    // opacity reaches 0.99, the lanes which are done just stop contributing
+    template <typename P>
+    void MarchPacket(const CpuVolumeView& volume, CpuRayBatch& batch, int first)
+    {
+        typedef typename P::Float Float;
+
+        Float entry_point[3], direction[3];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            entry_point[axis] = P::Load(batch.entry_point[axis] + first);
+            direction[axis] = P::Load(batch.direction[axis] + first);
+        }
+        const Float dt = P::Load(batch.dt + first);
+        const Float t_end = P::Load(batch.t_end + first);
+
+        // Note: The exponent of the opacity correction, 1 - (1 - alpha)^(dt * REF_SAMPLING_INTERVAL)
+        const Float correction = P::Mul(dt, P::Set(REF_SAMPLING_INTERVAL));
+
+        Float result[4] = { P::Set(0.f), P::Set(0.f), P::Set(0.f), P::Set(0.f) };
+        for (int i = 0; ; ++i)
+        {
+            const Float t = P::Mul(P::Add(P::Set((float)i), P::Set(0.5f)), dt);
+            const Float active = P::And(P::Less(t, t_end), P::Less(result[3], P::Set(0.99f)));
+            if (!P::Any(active))
+                break;
+
+            Float sample_position[3];
+            for (int axis = 0; axis < 3; ++axis)
+                sample_position[axis] = P::Add(entry_point[axis], P::Mul(t, direction[axis]));
+
+            Float color[4];
+            SampleTransferFunction<P>(volume, SampleVolume<P>(volume, sample_position), color);
+
+            // Opacity correction
+            const Float transparency = Exp2<P>(P::Mul(correction, Log2<P>(P::Sub(P::Set(1.f), color[3]))));
+            const Float alpha = P::Sub(P::Set(1.f), transparency);
+
+            // Note: Lanes which are done composite with a weight of 0
+            const Float weight = P::And(active, P::Sub(P::Set(1.f), result[3]));
+            for (int channel = 0; channel < 3; ++channel)
+                result[channel] = P::Add(result[channel], P::Mul(weight, P::Mul(color[channel], alpha)));
+            result[3] = P::Add(result[3], P::Mul(weight, alpha));
+        }
+
+        for (int channel = 0; channel < 4; ++channel)
+            P::Store(batch.color[channel] + first, result[channel]);
+    }
+
+    template <typename P>
+    void MarchRays(const CpuVolumeView& volume, CpuRayBatch& batch)
+    {
+        for (int first = 0; first < batch.count; first += P::WIDTH)
+            MarchPacket<P>(volume, batch, first);
+    }
+}
@@ -0,0 +1,73 @@
+#include "CpuPacketKernels.h"
+
+#if defined(CPU_X86_64)
+
+// Note: Everything from here on is compiled for AVX2 and FMA, the kernel is only ever called on CPUs which have them
+// (see GetBestInstructionSet). MSVC takes the intrinsics as they are, without enabling them for the whole file.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+
+#include <immintrin.h>
+
+#include "CpuPacketKernel.h"
+
+namespace
+{
+    struct PacketAVX2
+    {
+        static const int WIDTH = 8;
+
+        typedef __m256 Float;
+        typedef __m256i Int;
+
+        static inline Float Set(float v) { return _mm256_set1_ps(v); }
+        static inline Float Load(const float* p) { return _mm256_loadu_ps(p); }
+        static inline void Store(float* p, Float v) { _mm256_storeu_ps(p, v); }
+
+        static inline Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+        static inline Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+        static inline Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+        static inline Float Div(Float a, Float b) { return _mm256_div_ps(a, b); }
+        static inline Float Min(Float a, Float b) { return _mm256_min_ps(a, b); }
+        static inline Float Max(Float a, Float b) { return _mm256_max_ps(a, b); }
+        static inline Float Floor(Float a) { return _mm256_floor_ps(a); }
+
+        static inline Float Less(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static inline Float And(Float a, Float b) { return _mm256_and_ps(a, b); }
+        static inline Float Select(Float mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+        static inline bool Any(Float mask) { return _mm256_movemask_ps(mask) != 0; }
+
+        static inline Int SetInt(int v) { return _mm256_set1_epi32(v); }
+        static inline Int AddInt(Int a, Int b) { return _mm256_add_epi32(a, b); }
+        static inline Int SubInt(Int a, Int b) { return _mm256_sub_epi32(a, b); }
+        static inline Int MulInt(Int a, Int b) { return _mm256_mullo_epi32(a, b); }
+        static inline Int AndInt(Int a, Int b) { return _mm256_and_si256(a, b); }
+        static inline Int OrInt(Int a, Int b) { return _mm256_or_si256(a, b); }
+        template <int N> static inline Int ShiftRight(Int a) { return _mm256_srli_epi32(a, N); }
+        template <int N> static inline Int ShiftLeft(Int a) { return _mm256_slli_epi32(a, N); }
+
+        static inline Int ToInt(Float a) { return _mm256_cvttps_epi32(a); }
+        static inline Float ToFloat(Int a) { return _mm256_cvtepi32_ps(a); }
+        static inline Int AsInt(Float a) { return _mm256_castps_si256(a); }
+        static inline Float AsFloat(Int a) { return _mm256_castsi256_ps(a); }
+
+        static inline Float Gather(const float* base, Int index) { return _mm256_i32gather_ps(base, index, 4); }
+    };
+}
+
+void MarchRaysAVX2(const CpuVolumeView& volume, CpuRayBatch& batch)
+{
+    MarchRays<PacketAVX2>(volume, batch);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
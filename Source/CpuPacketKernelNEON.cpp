@@ -0,0 +1,68 @@
+#include "CpuPacketKernels.h"
+
+#if defined(CPU_ARM64)
+
+// Note: NEON is part of every ARMv8-A CPU, there is nothing to enable
+#include <arm_neon.h>
+
+#include "CpuPacketKernel.h"
+
+namespace
+{
+    struct PacketNEON
+    {
+        static const int WIDTH = 4;
+
+        typedef float32x4_t Float;
+        typedef int32x4_t Int;
+
+        static inline Float Set(float v) { return vdupq_n_f32(v); }
+        static inline Float Load(const float* p) { return vld1q_f32(p); }
+        static inline void Store(float* p, Float v) { vst1q_f32(p, v); }
+
+        static inline Float Add(Float a, Float b) { return vaddq_f32(a, b); }
+        static inline Float Sub(Float a, Float b) { return vsubq_f32(a, b); }
+        static inline Float Mul(Float a, Float b) { return vmulq_f32(a, b); }
+        static inline Float Div(Float a, Float b) { return vdivq_f32(a, b); }
+        static inline Float Min(Float a, Float b) { return vminq_f32(a, b); }
+        static inline Float Max(Float a, Float b) { return vmaxq_f32(a, b); }
+        static inline Float Floor(Float a) { return vrndmq_f32(a); }
+
+        // Note: Masks are kept as floats with all bits of the lanes which are true set, like SSE and AVX do
+        static inline Float Less(Float a, Float b) { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+        static inline Float And(Float a, Float b) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+        static inline Float Select(Float mask, Float a, Float b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+        static inline bool Any(Float mask) { return vmaxvq_u32(vreinterpretq_u32_f32(mask)) != 0; }
+
+        static inline Int SetInt(int v) { return vdupq_n_s32(v); }
+        static inline Int AddInt(Int a, Int b) { return vaddq_s32(a, b); }
+        static inline Int SubInt(Int a, Int b) { return vsubq_s32(a, b); }
+        static inline Int MulInt(Int a, Int b) { return vmulq_s32(a, b); }
+        static inline Int AndInt(Int a, Int b) { return vandq_s32(a, b); }
+        static inline Int OrInt(Int a, Int b) { return vorrq_s32(a, b); }
+        template <int N> static inline Int ShiftRight(Int a) { return vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(a), N)); }
+        template <int N> static inline Int ShiftLeft(Int a) { return vshlq_n_s32(a, N); }
+
+        static inline Int ToInt(Float a) { return vcvtq_s32_f32(a); }
+        static inline Float ToFloat(Int a) { return vcvtq_f32_s32(a); }
+        static inline Int AsInt(Float a) { return vreinterpretq_s32_f32(a); }
+        static inline Float AsFloat(Int a) { return vreinterpretq_f32_s32(a); }
+
+        // Note: NEON has no gather, the lanes are loaded one by one
+        static inline Float Gather(const float* base, Int index)
+        {
+            Float result = vdupq_n_f32(base[vgetq_lane_s32(index, 0)]);
+            result = vsetq_lane_f32(base[vgetq_lane_s32(index, 1)], result, 1);
+            result = vsetq_lane_f32(base[vgetq_lane_s32(index, 2)], result, 2);
+            result = vsetq_lane_f32(base[vgetq_lane_s32(index, 3)], result, 3);
+            return result;
+        }
+    };
+}
+
+void MarchRaysNEON(const CpuVolumeView& volume, CpuRayBatch& batch)
+{
+    MarchRays<PacketNEON>(volume, batch);
+}
+
+#endif
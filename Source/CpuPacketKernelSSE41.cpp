@@ -0,0 +1,79 @@
+#include "CpuPacketKernels.h"
+
+#if defined(CPU_X86_64)
+
+// Note: Everything from here on is compiled for SSE4.1, the kernel is only ever called on CPUs which have it (see
+// GetBestInstructionSet). MSVC takes the intrinsics as they are, without enabling them for the whole file.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse4.1"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#endif
+
+#include <smmintrin.h>
+
+#include "CpuPacketKernel.h"
+
+namespace
+{
+    struct PacketSSE41
+    {
+        static const int WIDTH = 4;
+
+        typedef __m128 Float;
+        typedef __m128i Int;
+
+        static inline Float Set(float v) { return _mm_set1_ps(v); }
+        static inline Float Load(const float* p) { return _mm_loadu_ps(p); }
+        static inline void Store(float* p, Float v) { _mm_storeu_ps(p, v); }
+
+        static inline Float Add(Float a, Float b) { return _mm_add_ps(a, b); }
+        static inline Float Sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+        static inline Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+        static inline Float Div(Float a, Float b) { return _mm_div_ps(a, b); }
+        static inline Float Min(Float a, Float b) { return _mm_min_ps(a, b); }
+        static inline Float Max(Float a, Float b) { return _mm_max_ps(a, b); }
+        static inline Float Floor(Float a) { return _mm_floor_ps(a); }
+
+        static inline Float Less(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+        static inline Float And(Float a, Float b) { return _mm_and_ps(a, b); }
+        static inline Float Select(Float mask, Float a, Float b) { return _mm_blendv_ps(b, a, mask); }
+        static inline bool Any(Float mask) { return _mm_movemask_ps(mask) != 0; }
+
+        static inline Int SetInt(int v) { return _mm_set1_epi32(v); }
+        static inline Int AddInt(Int a, Int b) { return _mm_add_epi32(a, b); }
+        static inline Int SubInt(Int a, Int b) { return _mm_sub_epi32(a, b); }
+        static inline Int MulInt(Int a, Int b) { return _mm_mullo_epi32(a, b); }
+        static inline Int AndInt(Int a, Int b) { return _mm_and_si128(a, b); }
+        static inline Int OrInt(Int a, Int b) { return _mm_or_si128(a, b); }
+        template <int N> static inline Int ShiftRight(Int a) { return _mm_srli_epi32(a, N); }
+        template <int N> static inline Int ShiftLeft(Int a) { return _mm_slli_epi32(a, N); }
+
+        static inline Int ToInt(Float a) { return _mm_cvttps_epi32(a); }
+        static inline Float ToFloat(Int a) { return _mm_cvtepi32_ps(a); }
+        static inline Int AsInt(Float a) { return _mm_castps_si128(a); }
+        static inline Float AsFloat(Int a) { return _mm_castsi128_ps(a); }
+
+        // Note: There is no gather before AVX2, the lanes are loaded one by one
+        static inline Float Gather(const float* base, Int index)
+        {
+            alignas(16) int indices[4];
+            _mm_store_si128((Int*)indices, index);
+            return _mm_setr_ps(base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]]);
+        }
+    };
+}
+
+void MarchRaysSSE41(const CpuVolumeView& volume, CpuRayBatch& batch)
+{
+    MarchRays<PacketSSE41>(volume, batch);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef CPU_PACKET_KERNELS_H
+
+#include "MortonVolume.h"
+#include "RenderConstants.h"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define CPU_X86_64
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define CPU_ARM64
+#endif
+
+// The volume and the transfer function as the packet kernels see them, see CpuRayCaster
+struct CpuVolumeView
+{
+    // Voxels in the layout of MortonVolume, mapped to [0, 1] (but not clamped to it)
+    const float* values;
+    glm::ivec3 dimensions;
+    int brick_strides[3];
+
+    // One array per channel (red, green, blue, opacity) so that every channel can be gathered on its own
+    const float* transfer_function[4];
+    int transfer_function_size;
+};
+
+// The rays of a tile, set up by CpuRayCaster, one array per component. The kernels march rays `count` of them (padded
+// to a multiple of the widest packet, rays with t_end = 0 are done from the start) and write back their composited
+// (premultiplied) colour.
+struct CpuRayBatch
+{
+    static const int CAPACITY = 256;
+
+    int count;
+    float entry_point[3][CAPACITY];
+    float direction[3][CAPACITY];
+    float dt[CAPACITY];
+    float t_end[CAPACITY];
+
+    float color[4][CAPACITY];
+};
+
+// Packet kernels, one per instruction set, which march the rays of a batch in packets of 4 (SSE4.1, NEON) or 8 (AVX2)
+// neighbouring rays. They are the reference loop of CpuRayCaster::MarchRay, lane by lane.
+#if defined(CPU_X86_64)
+void MarchRaysSSE41(const CpuVolumeView& volume, CpuRayBatch& batch);
+void MarchRaysAVX2(const CpuVolumeView& volume, CpuRayBatch& batch);
+#elif defined(CPU_ARM64)
+void MarchRaysNEON(const CpuVolumeView& volume, CpuRayBatch& batch);
+#endif
+
+#define CPU_PACKET_KERNELS_H
+#endif
@@ -0,0 +1,298 @@
+#include "CpuRayCaster.h"
+#include "CpuPacketKernels.h"
+#include "RenderConstants.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#if defined(CPU_X86_64)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// Square tiles of pixels handed out to the threads, small enough that the expensive ones (rays through dense parts of
+// the volume) spread over every thread, big enough for the rays of a tile to share the cache
+#define CPU_TILE_SIZE 16
+static_assert(CPU_TILE_SIZE * CPU_TILE_SIZE <= CpuRayBatch::CAPACITY, "The rays of a tile have to fit a batch");
+
+// Batches are padded to a multiple of the widest packet
+#define CPU_MAX_PACKET_WIDTH 8
+
+CpuInstructionSet GetBestInstructionSet()
+{
+#if defined(CPU_X86_64)
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    const int max_leaf = info[0];
+
+    __cpuid(info, 1);
+    const bool sse41 = (info[2] & (1 << 19)) != 0;
+    const bool fma = (info[2] & (1 << 12)) != 0;
+
+    // Note: The AVX registers are only usable if the OS saves them on context switches
+    const bool avx_enabled = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+
+    bool avx2 = false;
+    if (max_leaf >= 7)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+
+    if (avx2 && fma && avx_enabled)
+        return CpuInstructionSet::AVX2;
+    if (sse41)
+        return CpuInstructionSet::SSE41;
+#else
+    // Note: These check that the OS saves the AVX registers as well
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return CpuInstructionSet::AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return CpuInstructionSet::SSE41;
+#endif
+#elif defined(CPU_ARM64)
+    // Note: The NEON kernel has never been compiled or checked against the scalar loop on ARM64 hardware, so it is left
+    // to the builds which define CPU_ENABLE_NEON until it has been
+#if defined(CPU_ENABLE_NEON)
+    return CpuInstructionSet::NEON;
+#endif
+#endif
+
+    return CpuInstructionSet::SCALAR;
+}
+
+const char* GetInstructionSetName(CpuInstructionSet instruction_set)
+{
+    switch (instruction_set)
+    {
+        case CpuInstructionSet::SSE41: return "SSE4.1";
+        case CpuInstructionSet::AVX2: return "AVX2";
+        case CpuInstructionSet::NEON: return "NEON";
+        default: return "Scalar";
+    }
+}
+
+typedef void (*MarchRaysFunction)(const CpuVolumeView& volume, CpuRayBatch& batch);
+
+// The packet kernel for `instruction_set`, nullptr for the scalar loop (or an instruction set this build has no
+// kernel for)
+static MarchRaysFunction GetMarchRaysFunction(CpuInstructionSet instruction_set)
+{
+    switch (instruction_set)
+    {
+#if defined(CPU_X86_64)
+        case CpuInstructionSet::SSE41: return MarchRaysSSE41;
+        case CpuInstructionSet::AVX2: return MarchRaysAVX2;
+#elif defined(CPU_ARM64)
+        case CpuInstructionSet::NEON: return MarchRaysNEON;
+#endif
+        default: return nullptr;
+    }
+}
+
+glm::vec4 BlendBackground(const glm::vec4& color)
+{
+    const glm::vec4 bg_color(0.5f, 0.5f, 0.5f, 1.f);
+
+    const glm::vec3 rgb = bg_color.a * glm::vec3(bg_color) * (1.f - color.a) + glm::vec3(color) * color.a;
+    return glm::vec4(rgb, color.a + bg_color.a - color.a * bg_color.a);
+}
+
+CpuRayCaster::CpuRayCaster(const glm::ivec3& dimensions, const unsigned char* voxels, VolumeDataType type, const glm::vec2& value_range)
+    : dimensions(dimensions)
+{
+    // Note: An empty range (a constant volume) would divide by zero, everything maps to 0 instead like it does on the GPU
+    const float extent = value_range.y - value_range.x;
+    const float scale = (extent > 0.f) ? 1.f / extent : 0.f;
+    const float bias = (extent > 0.f) ? -value_range.x / extent : 0.f;
+    volume = MortonVolume(dimensions, voxels, type, scale, bias);
+
+    // Note: Starts out fully transparent, nothing shows up until a transfer function is set
+    for (int channel = 0; channel < 4; ++channel)
+        transfer_function[channel].assign(1, 0.f);
+}
+
+void CpuRayCaster::SetTransferFunction(const std::vector<uint8_t>& colormap)
+{
+    const size_t texel_count = colormap.size() / 4;
+    for (int channel = 0; channel < 4; ++channel)
+    {
+        transfer_function[channel].assign(std::max<size_t>(texel_count, 1), 0.f);
+        for (size_t i = 0; i < texel_count; ++i)
+            transfer_function[channel][i] = colormap[i * 4 + channel] / 255.f;
+    }
+}
+
+float CpuRayCaster::SampleVolume(const glm::vec3& position) const
+{
+    return std::clamp(volume.Sample(position), 0.f, 1.f);
+}
+
+glm::vec4 CpuRayCaster::SampleTransferFunction(float value) const
+{
+    // Note: Linear filtering of a 1D texture, texel centres at (i + 0.5) / size and clamped to the edge
+    const int texel_count = (int)transfer_function[0].size();
+    const float position = value * (float)texel_count - 0.5f;
+    const float base = std::floor(position);
+    const float f = position - base;
+
+    const int i0 = std::clamp((int)base, 0, texel_count - 1);
+    const int i1 = std::clamp((int)base + 1, 0, texel_count - 1);
+
+    glm::vec4 color;
+    for (int channel = 0; channel < 4; ++channel)
+        color[channel] = transfer_function[channel][i0] + (transfer_function[channel][i1] - transfer_function[channel][i0]) * f;
+    return color;
+}
+
+// Note: Mirrors GetRay of Shaders/RayMarching.glsl, keep them in sync
+bool CpuRayCaster::SetUpRay(const glm::vec2& pixel, const glm::vec2& size, const glm::mat4& inverse_pvm, glm::vec3& entry_point,
+    glm::vec3& direction, float& dt, float& t_end) const
+{
+    const glm::vec2 ndc = pixel / size * 2.f - 1.f;
+    const glm::vec4 near_point = inverse_pvm * glm::vec4(ndc, -1.f, 1.f);
+    const glm::vec4 far_point = inverse_pvm * glm::vec4(ndc, 1.f, 1.f);
+    const glm::vec3 origin = glm::vec3(near_point) / near_point.w;
+    const glm::vec3 ray = glm::vec3(far_point) / far_point.w - origin;
+
+    // Slab test, t runs from the near plane (0) to the far plane (1)
+    const glm::vec3 t0 = (glm::vec3(0.f) - origin) / ray;
+    const glm::vec3 t1 = (glm::vec3(1.f) - origin) / ray;
+    const glm::vec3 t_min = glm::min(t0, t1);
+    const glm::vec3 t_max = glm::max(t0, t1);
+    const float t_entry = std::max(std::max(std::max(t_min.x, t_min.y), t_min.z), 0.f);
+    const float t_exit = std::min(std::min(std::min(t_max.x, t_max.y), t_max.z), 1.f);
+    if (t_entry >= t_exit)
+        return false;
+
+    entry_point = glm::clamp(origin + t_entry * ray, 0.f, 1.f);
+    const glm::vec3 exit_point = glm::clamp(origin + t_exit * ray, 0.f, 1.f);
+
+    direction = exit_point - entry_point;
+    t_end = glm::length(direction);
+
+    // Note: Rays which only graze an edge have nothing to step through
+    if (t_end <= 0.f)
+        return false;
+
+    dt = std::min(t_end, t_end / (sampling_rate * glm::length(direction * glm::vec3(dimensions))));
+    direction = glm::normalize(direction);
+    return true;
+}
+
+// Note: Mirrors RayTraversal of Shaders/RayMarching.glsl, keep them (and CpuPacketKernel.h) in sync
+glm::vec4 CpuRayCaster::MarchRay(const glm::vec3& entry_point, const glm::vec3& direction, float dt, float t_end) const
+{
+    glm::vec4 result(0.f);
+    for (int i = 0; ((float)i + 0.5f) * dt < t_end; ++i)
+    {
+        const glm::vec3 sample_position = entry_point + (((float)i + 0.5f) * dt) * direction;
+        glm::vec4 color = SampleTransferFunction(SampleVolume(sample_position));
+
+        // Opacity correction
+        color.a = 1.f - std::pow(1.f - color.a, dt * REF_SAMPLING_INTERVAL);
+
+        result += (1.f - result.a) * glm::vec4(glm::vec3(color) * color.a, color.a);
+        if (result.a >= 0.99f)
+            break;
+    }
+
+    return result;
+}
+
+void CpuRayCaster::Render(const glm::mat4& inverse_pvm, int width, int height, std::vector<uint8_t>& pixels, ThreadPool& thread_pool) const
+{
+    pixels.resize((size_t)width * height * 4);
+
+    const int tiles_x = (width + CPU_TILE_SIZE - 1) / CPU_TILE_SIZE;
+    const int tiles_y = (height + CPU_TILE_SIZE - 1) / CPU_TILE_SIZE;
+    const glm::vec2 size((float)width, (float)height);
+
+    // Note: The packet kernels can't address volumes with more voxels than their 32 bit gathers reach, which only the
+    // scalar loop (64 bit offsets) renders
+    const bool packet_addressable = volume.values.size() <= MORTON_MAX_PACKET_VOXEL_COUNT;
+    const MarchRaysFunction march_rays = packet_addressable ? GetMarchRaysFunction(instruction_set) : nullptr;
+    assert(!march_rays || volume.brick_strides[2] <= INT32_MAX);
+    const CpuVolumeView view = { volume.values.data(), dimensions, { (int)volume.brick_strides[0], (int)volume.brick_strides[1],
+        (int)volume.brick_strides[2] }, { transfer_function[0].data(), transfer_function[1].data(), transfer_function[2].data(),
+        transfer_function[3].data() }, (int)transfer_function[0].size() };
+
+    // Note: A tile is a task of its own, tiles which miss the volume cost next to nothing while the ones through dense
+    // parts of it run every ray to the end, stealing evens that out
+    thread_pool.ParallelFor((size_t)tiles_x * tiles_y, [&](size_t tile)
+    {
+        const int x_begin = (int)(tile % tiles_x) * CPU_TILE_SIZE;
+        const int y_begin = (int)(tile / tiles_x) * CPU_TILE_SIZE;
+        const int x_end = std::min(x_begin + CPU_TILE_SIZE, width);
+        const int y_end = std::min(y_begin + CPU_TILE_SIZE, height);
+
+        // Note: Rays which miss the volume go through the batch as well, with nothing to march
+        CpuRayBatch batch;
+        batch.count = 0;
+        for (int y = y_begin; y < y_end; ++y)
+        {
+            for (int x = x_begin; x < x_end; ++x)
+            {
+                glm::vec3 entry_point, direction;
+                float dt, t_end;
+                const int i = batch.count++;
+                if (!SetUpRay(glm::vec2(x, y) + 0.5f, size, inverse_pvm, entry_point, direction, dt, t_end))
+                {
+                    entry_point = direction = glm::vec3(0.f);
+                    dt = t_end = 0.f;
+                }
+
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    batch.entry_point[axis][i] = entry_point[axis];
+                    batch.direction[axis][i] = direction[axis];
+                }
+                batch.dt[i] = dt;
+                batch.t_end[i] = t_end;
+            }
+        }
+
+        if (march_rays)
+        {
+            const int ray_count = batch.count;
+            while (batch.count % CPU_MAX_PACKET_WIDTH != 0)
+            {
+                const int i = batch.count++;
+                for (int axis = 0; axis < 3; ++axis)
+                    batch.entry_point[axis][i] = batch.direction[axis][i] = 0.f;
+                batch.dt[i] = batch.t_end[i] = 0.f;
+            }
+
+            march_rays(view, batch);
+            batch.count = ray_count;
+        }
+        else
+        {
+            for (int i = 0; i < batch.count; ++i)
+            {
+                const glm::vec4 color = MarchRay(glm::vec3(batch.entry_point[0][i], batch.entry_point[1][i], batch.entry_point[2][i]),
+                    glm::vec3(batch.direction[0][i], batch.direction[1][i], batch.direction[2][i]), batch.dt[i], batch.t_end[i]);
+                for (int channel = 0; channel < 4; ++channel)
+                    batch.color[channel][i] = color[channel];
+            }
+        }
+
+        int i = 0;
+        for (int y = y_begin; y < y_end; ++y)
+        {
+            // Note: y runs up from the bottom like gl_FragCoord does, the rows are stored top first
+            uint8_t* row = pixels.data() + (size_t)(height - 1 - y) * width * 4;
+            for (int x = x_begin; x < x_end; ++x, ++i)
+            {
+                const glm::vec4 color = glm::clamp(BlendBackground(glm::vec4(batch.color[0][i], batch.color[1][i], batch.color[2][i], batch.color[3][i])), 0.f, 1.f);
+                for (int channel = 0; channel < 4; ++channel)
+                    row[x * 4 + channel] = (uint8_t)(color[channel] * 255.f + 0.5f);
+            }
+        }
+    }, 1);
+}
@@ -0,0 +1,75 @@
+#ifndef CPU_RAY_CASTER_H
+
+#include "MortonVolume.h"
+#include "ThreadPool.h"
+#include "Volume.h"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Reference ray caster which runs on the CPU alone, for machines without a GPU (and for checking the GPU ray casters
+// against). It is the algorithm of RayTraversal in Shaders/RayMarching.glsl: rays set up analytically from the
+// inverse of the projection-view-model matrix, opacity correction against REF_SAMPLING_INTERVAL, front to back
+// compositing until an opacity of 0.99 and the same background blend. There is no empty space skipping, jitter or
+// pre-integration, none of them change the image beyond noise.
+//
+// Note: The image is cut into tiles which are spread over the ThreadPool, so it renders on every core. The rays of a
+// tile are marched in packets with the widest instruction set the CPU has (see CpuPacketKernel.h), the scalar loop is
+// the reference they are checked against.
+enum class CpuInstructionSet
+{
+    SCALAR,
+    SSE41,
+    AVX2,
+    NEON
+};
+
+// The widest instruction set which both the CPU and the OS support
+CpuInstructionSet GetBestInstructionSet();
+const char* GetInstructionSetName(CpuInstructionSet instruction_set);
+
+// Blends `color` (premultiplied) over the background, the same as BlendBackground in Shaders/RayMarching.glsl
+glm::vec4 BlendBackground(const glm::vec4& color);
+
+struct CpuRayCaster
+{
+    // Takes a copy of the voxels (`dimensions`, X-major, little endian) mapped to [0, 1] over `value_range`, the same
+    // values the ray casters sample from the texture after the remap
+    CpuRayCaster(const glm::ivec3& dimensions, const unsigned char* voxels, VolumeDataType type, const glm::vec2& value_range);
+
+    // RGBA8 texels spanning [0, 1], as TransferFunctionWidget hands them out
+    void SetTransferFunction(const std::vector<uint8_t>& colormap);
+
+    // Renders a `width` x `height` image into `pixels`, RGBA8 with the top row first (ready for stbi_write_png), on the
+    // threads of `thread_pool`
+    void Render(const glm::mat4& inverse_pvm, int width, int height, std::vector<uint8_t>& pixels,
+        ThreadPool& thread_pool = ThreadPool::Get()) const;
+
+    float sampling_rate = 1.f;
+    CpuInstructionSet instruction_set = GetBestInstructionSet();
+
+    const glm::ivec3 dimensions;
+
+private:
+    // Trilinear filtering of the voxels around `position` in [0, 1]^3, clamped to [0, 1]
+    float SampleVolume(const glm::vec3& position) const;
+    glm::vec4 SampleTransferFunction(float value) const;
+
+    // Sets up the ray through `pixel` of a `size` image, from where it enters the volume to where it leaves it. False
+    // if it misses the volume.
+    bool SetUpRay(const glm::vec2& pixel, const glm::vec2& size, const glm::mat4& inverse_pvm, glm::vec3& entry_point,
+        glm::vec3& direction, float& dt, float& t_end) const;
+
+    // Composites the samples of a ray front to back, one at a time
+    glm::vec4 MarchRay(const glm::vec3& entry_point, const glm::vec3& direction, float dt, float t_end) const;
+
+    // Note: Bricked, so that the speed of the ray caster doesn't depend on the direction of the rays
+    MortonVolume volume;
+
+    // One array per channel, as the packet kernels gather them
+    std::vector<float> transfer_function[4];
+};
+
+#define CPU_RAY_CASTER_H
+#endif
@@ -0,0 +1,190 @@
+#include "Downsample.h"
+#include "ThreadPool.h"
+
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+// Note: SSE2 is part of every x64 CPU, so it doesn't need a runtime check
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define DOWNSAMPLE_SSE2
+#endif
+
+glm::ivec3 GetDownsampledDimensions(const glm::ivec3& dimensions, int factor)
+{
+    return glm::max(dimensions / factor, glm::ivec3(1));
+}
+
+int GetMipLevelCount(const glm::ivec3& dimensions)
+{
+    int level_count = 1;
+    for (int size = std::max(dimensions.x, std::max(dimensions.y, dimensions.z)); size > 1; size /= 2)
+        ++level_count;
+
+    return level_count;
+}
+
+#ifdef DOWNSAMPLE_SSE2
+static inline void AddIntegers(__m128i values, float* sums)
+{
+    _mm_storeu_ps(sums, _mm_add_ps(_mm_loadu_ps(sums), _mm_cvtepi32_ps(values)));
+}
+
+static inline void AddUnsignedShorts(__m128i values, float* sums)
+{
+    const __m128i zero = _mm_setzero_si128();
+    AddIntegers(_mm_unpacklo_epi16(values, zero), sums);
+    AddIntegers(_mm_unpackhi_epi16(values, zero), sums + 4);
+}
+#endif
+
+template <typename T>
+static void AccumulateRow(const unsigned char* row, int begin, int count, float* sums)
+{
+    for (int i = begin; i < count; ++i)
+    {
+        T value;
+        memcpy(&value, row + i * sizeof(T), sizeof(T));
+        sums[i] += (float)value;
+    }
+}
+
+// Adds every voxel of the row to the matching element of `sums`
+static void AccumulateRow(const unsigned char* row, int count, VolumeDataType type, float* sums)
+{
+    int i = 0;
+#ifdef DOWNSAMPLE_SSE2
+    if (type == VolumeDataType::UINT8)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= count; i += 16)
+        {
+            const __m128i bytes = _mm_loadu_si128((const __m128i*)(row + i));
+            AddUnsignedShorts(_mm_unpacklo_epi8(bytes, zero), sums + i);
+            AddUnsignedShorts(_mm_unpackhi_epi8(bytes, zero), sums + i + 8);
+        }
+    }
+    else if (type == VolumeDataType::UINT16)
+    {
+        for (; i + 8 <= count; i += 8)
+            AddUnsignedShorts(_mm_loadu_si128((const __m128i*)(row + i * 2)), sums + i);
+    }
+    else if (type == VolumeDataType::FLOAT32)
+    {
+        for (; i + 4 <= count; i += 4)
+            _mm_storeu_ps(sums + i, _mm_add_ps(_mm_loadu_ps(sums + i), _mm_loadu_ps((const float*)(row + i * 4))));
+    }
+#endif
+
+    // The rest of the row, and the data types without a vectorized path
+    switch (type)
+    {
+        case VolumeDataType::UINT8: AccumulateRow<uint8_t>(row, i, count, sums); break;
+        case VolumeDataType::UINT16: AccumulateRow<uint16_t>(row, i, count, sums); break;
+        case VolumeDataType::INT16: AccumulateRow<int16_t>(row, i, count, sums); break;
+        case VolumeDataType::UINT32: AccumulateRow<uint32_t>(row, i, count, sums); break;
+        case VolumeDataType::FLOAT32: AccumulateRow<float>(row, i, count, sums); break;
+        case VolumeDataType::FLOAT16:
+        {
+            for (; i < count; ++i)
+                sums[i] += GetVoxelValue(row + i * 2, type);
+            break;
+        }
+    }
+}
+
+template <typename T>
+static inline void StoreRounded(float value, unsigned char* dst)
+{
+    // Note: Clamped in double, float can't represent the largest 32 bit integers
+    const double rounded = std::clamp((double)std::round(value), (double)std::numeric_limits<T>::lowest(), (double)std::numeric_limits<T>::max());
+    const T result = (T)rounded;
+    memcpy(dst, &result, sizeof(result));
+}
+
+static void StoreVoxel(float value, VolumeDataType type, unsigned char* dst)
+{
+    switch (type)
+    {
+        case VolumeDataType::UINT8: StoreRounded<uint8_t>(value, dst); break;
+        case VolumeDataType::UINT16: StoreRounded<uint16_t>(value, dst); break;
+        case VolumeDataType::INT16: StoreRounded<int16_t>(value, dst); break;
+        case VolumeDataType::UINT32: StoreRounded<uint32_t>(value, dst); break;
+        case VolumeDataType::FLOAT16:
+        {
+            const uint16_t half = (uint16_t)glm::packHalf1x16(value);
+            memcpy(dst, &half, sizeof(half));
+            break;
+        }
+        case VolumeDataType::FLOAT32: memcpy(dst, &value, sizeof(value)); break;
+    }
+}
+
+void DownsampleVolume(const unsigned char* src, const glm::ivec3& src_dimensions, VolumeDataType type, int factor, unsigned char* dst)
+{
+    const glm::ivec3 dst_dimensions = GetDownsampledDimensions(src_dimensions, factor);
+    const unsigned int byte_count = GetDataTypeSize(type);
+    const size_t src_row_size = (size_t)src_dimensions.x * byte_count;
+
+    // The source voxels [x, y) along an axis which make up voxel `i` of the destination
+    auto get_footprint = [factor](int i, int dst_size, int src_size)
+    {
+        return glm::ivec2(i * factor, (i == dst_size - 1) ? src_size : (i + 1) * factor);
+    };
+
+    ThreadPool::Get().ParallelFor((size_t)dst_dimensions.y * dst_dimensions.z, [&](size_t row)
+    {
+        const glm::ivec2 y_range = get_footprint((int)(row % dst_dimensions.y), dst_dimensions.y, src_dimensions.y);
+        const glm::ivec2 z_range = get_footprint((int)(row / dst_dimensions.y), dst_dimensions.z, src_dimensions.z);
+
+        // Sum up the source rows of the blocks first (contiguous, so this is where the vectorization pays off), then
+        // every block along the row
+        thread_local std::vector<float> sums;
+        sums.assign(src_dimensions.x, 0.f);
+        for (int z = z_range.x; z < z_range.y; ++z)
+        {
+            for (int y = y_range.x; y < y_range.y; ++y)
+                AccumulateRow(src + ((size_t)z * src_dimensions.y + y) * src_row_size, src_dimensions.x, type, sums.data());
+        }
+
+        const int row_count = (y_range.y - y_range.x) * (z_range.y - z_range.x);
+        unsigned char* dst_row = dst + row * dst_dimensions.x * byte_count;
+        for (int x = 0; x < dst_dimensions.x; ++x)
+        {
+            const glm::ivec2 x_range = get_footprint(x, dst_dimensions.x, src_dimensions.x);
+
+            float sum = 0.f;
+            for (int i = x_range.x; i < x_range.y; ++i)
+                sum += sums[i];
+
+            StoreVoxel(sum / (float)(row_count * (x_range.y - x_range.x)), type, dst_row + x * byte_count);
+        }
+    });
+}
+
+std::vector<std::vector<unsigned char>> BuildMipChain(const unsigned char* voxels, const glm::ivec3& dimensions, VolumeDataType type)
+{
+    const unsigned int byte_count = GetDataTypeSize(type);
+    const int level_count = GetMipLevelCount(dimensions);
+
+    std::vector<std::vector<unsigned char>> levels;
+    levels.reserve(level_count - 1);
+
+    const unsigned char* previous = voxels;
+    glm::ivec3 previous_dimensions = dimensions;
+    for (int level = 1; level < level_count; ++level)
+    {
+        const glm::ivec3 level_dimensions = GetDownsampledDimensions(previous_dimensions, 2);
+        levels.emplace_back((size_t)level_dimensions.x * level_dimensions.y * level_dimensions.z * byte_count);
+        DownsampleVolume(previous, previous_dimensions, type, 2, levels.back().data());
+
+        previous = levels.back().data();
+        previous_dimensions = level_dimensions;
+    }
+
+    return levels;
+}
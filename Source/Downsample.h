@@ -0,0 +1,29 @@
+#ifndef DOWNSAMPLE_H
+
+#include "Volume.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Dimensions of a volume reduced by `factor` along every axis, never less than a voxel. A factor of 2 gives the
+// dimensions of the next mip level, the same way OpenGL rounds them.
+glm::ivec3 GetDownsampledDimensions(const glm::ivec3& dimensions, int factor);
+
+// Box filters the voxels in `src` (tightly packed in X-major order, little endian) down by `factor` along every axis
+// into `dst`, which has the dimensions GetDownsampledDimensions() gives. Every voxel of `dst` is the average of a
+// factor^3 block of `src`, the last voxel along each axis also takes in whatever is left over by the division so
+// no voxel of `src` is ever dropped. Integers are rounded to the nearest value.
+//
+// Rows of `dst` are filtered in parallel, the inner loops are vectorized for the 8 and 16 bit unsigned and 32 bit
+// float volumes.
+void DownsampleVolume(const unsigned char* src, const glm::ivec3& src_dimensions, VolumeDataType type, int factor, unsigned char* dst);
+
+// Returns mip levels 1 and up of the volume in `voxels` (level 0), each one half the size of the previous one down to
+// a single voxel. Much faster than glGenerateMipmap() on 3D textures, which most drivers do on the CPU, one thread.
+std::vector<std::vector<unsigned char>> BuildMipChain(const unsigned char* voxels, const glm::ivec3& dimensions, VolumeDataType type);
+
+// Number of levels of a full mip chain of a texture with the given dimensions, level 0 included
+int GetMipLevelCount(const glm::ivec3& dimensions);
+
+#define DOWNSAMPLE_H
+#endif
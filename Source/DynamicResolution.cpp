@@ -0,0 +1,77 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+DynamicResolution::DynamicResolution()
+{
+    for (PendingQuery& pending : queries)
+        glGenQueries(1, &pending.query);
+}
+
+DynamicResolution::~DynamicResolution()
+{
+    for (PendingQuery& pending : queries)
+        glDeleteQueries(1, &pending.query);
+}
+
+void DynamicResolution::BeginPass()
+{
+    if (queries[next_query].in_flight)
+        return;
+
+    glBeginQuery(GL_TIME_ELAPSED, queries[next_query].query);
+    active_query = next_query;
+}
+
+void DynamicResolution::EndPass(int pixel_count, float sampling_rate_scale)
+{
+    if (active_query < 0)
+        return;
+
+    glEndQuery(GL_TIME_ELAPSED);
+
+    queries[active_query].in_flight = true;
+    queries[active_query].samples = (float)pixel_count * sampling_rate_scale;
+    next_query = (active_query + 1) % QUERY_COUNT;
+    active_query = -1;
+}
+
+void DynamicResolution::Update()
+{
+    // Note: Oldest first, the queries finish in the order they were issued
+    for (int i = 0; i < QUERY_COUNT; ++i)
+    {
+        PendingQuery& pending = queries[(next_query + i) % QUERY_COUNT];
+        if (!pending.in_flight)
+            continue;
+
+        GLint available = 0;
+        glGetQueryObjectiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        GLuint64 elapsed_ns = 0;
+        glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &elapsed_ns);
+        pending.in_flight = false;
+
+        last_pass_ms = (float)(elapsed_ns / 1e6);
+        if (pending.samples <= 0.f)
+            continue;
+
+        // Note: Smoothed, so a single slow frame doesn't make the resolution jump around
+        const double measured = last_pass_ms / pending.samples;
+        ms_per_sample = (ms_per_sample < 0.0) ? measured : ms_per_sample + 0.25 * (measured - ms_per_sample);
+    }
+}
+
+float DynamicResolution::GetResolutionScale(int pixel_count, float sampling_rate_scale) const
+{
+    if (ms_per_sample <= 0.0 || pixel_count <= 0)
+        return 1.f;
+
+    // The sample count goes with the square of the scale
+    const double full_resolution_ms = ms_per_sample * pixel_count * sampling_rate_scale;
+    const float scale = (float)std::sqrt(budget_ms / full_resolution_ms);
+    return std::clamp(scale, min_scale, 1.f);
+}
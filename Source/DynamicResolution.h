@@ -0,0 +1,55 @@
+#ifndef DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+
+// Picks the resolution the volume is ray cast at so the pass fits a frame time budget. The pass is timed on the GPU with
+// timer queries, and its cost is taken to be proportional to the number of samples it takes, pixels times sampling
+// rate, so one measurement says what any other resolution or sampling rate would cost.
+//
+// Note: Query results come back a few frames late, the queries rotate through a small ring so that reading them never
+// stalls the pipeline. A frame whose query can't be started (every one of them still in flight) just isn't timed.
+struct DynamicResolution
+{
+    DynamicResolution();
+    ~DynamicResolution();
+
+    DynamicResolution(const DynamicResolution&) = delete;
+    DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+    // Brackets the GPU work of the ray casting pass, `pixel_count` pixels at `sampling_rate_scale` times the sampling rate
+    void BeginPass();
+    void EndPass(int pixel_count, float sampling_rate_scale);
+
+    // Reads back the queries which are done, call once per frame
+    void Update();
+
+    // The scale of both sides of the image (in (0, 1]) for a pass over `pixel_count` pixels at full resolution to fit the
+    // budget, 1 until there is a measurement to go by
+    float GetResolutionScale(int pixel_count, float sampling_rate_scale) const;
+
+    float budget_ms = 16.f;
+    float min_scale = 0.25f;
+
+    // Duration of the last pass which got timed
+    float last_pass_ms = 0.f;
+
+private:
+    static const int QUERY_COUNT = 4;
+
+    struct PendingQuery
+    {
+        GLuint query;
+        bool in_flight = false;
+        float samples = 0.f;
+    };
+
+    PendingQuery queries[QUERY_COUNT];
+    int next_query = 0;
+    int active_query = -1;
+
+    // Smoothed GPU time per sample, a pixel at the full sampling rate, negative until the first measurement
+    double ms_per_sample = -1.0;
+};
+
+#define DYNAMIC_RESOLUTION_H
+#endif
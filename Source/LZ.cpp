@@ -0,0 +1,196 @@
+#include "LZ.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Note: Constants of the LZ4 block format. The last match must start at least MF_LIMIT bytes before the end of the
+// input and the last LAST_LITERALS bytes are always literals.
+#define MIN_MATCH 4
+#define MF_LIMIT 12
+#define LAST_LITERALS 5
+#define MAX_OFFSET 65535
+#define HASH_BITS 16
+
+static inline uint32_t Read32(const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t Hash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Lengths of 15 and above spill over into extra bytes of 255 each, terminated by a byte less than 255
+static inline bool WriteLength(size_t length, unsigned char* dst, size_t& op, size_t dst_capacity)
+{
+    for (; length >= 255; length -= 255)
+    {
+        if (op >= dst_capacity)
+            return false;
+        dst[op++] = 255;
+    }
+
+    if (op >= dst_capacity)
+        return false;
+    dst[op++] = (unsigned char)length;
+
+    return true;
+}
+
+static inline bool ReadLength(const unsigned char* src, size_t src_size, size_t& ip, size_t& length)
+{
+    unsigned char byte;
+    do
+    {
+        if (ip >= src_size)
+            return false;
+        byte = src[ip++];
+        length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+static bool WriteSequence(const unsigned char* literals, size_t literal_length, size_t offset, size_t match_length,
+    unsigned char* dst, size_t& op, size_t dst_capacity)
+{
+    if (op >= dst_capacity)
+        return false;
+
+    // Token: literal length in the high nibble, match length (minus MIN_MATCH) in the low one
+    size_t token_op = op++;
+    dst[token_op] = (unsigned char)((literal_length < 15 ? literal_length : 15) << 4);
+    if (literal_length >= 15 && !WriteLength(literal_length - 15, dst, op, dst_capacity))
+        return false;
+
+    if (op + literal_length > dst_capacity)
+        return false;
+    memcpy(dst + op, literals, literal_length);
+    op += literal_length;
+
+    // Note: The last sequence is literals only
+    if (match_length == 0)
+        return true;
+
+    if (op + 2 > dst_capacity)
+        return false;
+    dst[op++] = (unsigned char)(offset & 0xFF);
+    dst[op++] = (unsigned char)(offset >> 8);
+
+    match_length -= MIN_MATCH;
+    dst[token_op] |= (unsigned char)(match_length < 15 ? match_length : 15);
+    if (match_length >= 15 && !WriteLength(match_length - 15, dst, op, dst_capacity))
+        return false;
+
+    return true;
+}
+
+size_t LZCompressBound(size_t src_size)
+{
+    return src_size + src_size / 255 + 16;
+}
+
+size_t LZCompress(const unsigned char* src, size_t src_size, unsigned char* dst, size_t dst_capacity)
+{
+    size_t ip = 0;
+    size_t anchor = 0;
+    size_t op = 0;
+
+    if (src_size > MF_LIMIT)
+    {
+        // Note: Positions are stored as is, a stale or empty (0) entry is caught by comparing the bytes
+        std::vector<uint32_t> hash_table((size_t)1 << HASH_BITS, 0);
+
+        const size_t match_start_limit = src_size - MF_LIMIT;
+        const size_t match_end_limit = src_size - LAST_LITERALS;
+        unsigned int misses = 0;
+
+        while (ip < match_start_limit)
+        {
+            const uint32_t sequence = Read32(src + ip);
+            const uint32_t hash = Hash(sequence);
+            const size_t candidate = hash_table[hash];
+            hash_table[hash] = (uint32_t)ip;
+
+            if (candidate >= ip || ip - candidate > MAX_OFFSET || Read32(src + candidate) != sequence)
+            {
+                // Skip ahead faster and faster through incompressible data
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+
+            size_t match_length = MIN_MATCH;
+            while (ip + match_length < match_end_limit && src[candidate + match_length] == src[ip + match_length])
+                ++match_length;
+
+            if (!WriteSequence(src + anchor, ip - anchor, ip - candidate, match_length, dst, op, dst_capacity))
+                return 0;
+
+            ip += match_length;
+            anchor = ip;
+        }
+    }
+
+    if (!WriteSequence(src + anchor, src_size - anchor, 0, 0, dst, op, dst_capacity))
+        return 0;
+
+    return op;
+}
+
+bool LZDecompress(const unsigned char* src, size_t src_size, unsigned char* dst, size_t dst_size)
+{
+    size_t ip = 0;
+    size_t op = 0;
+
+    while (ip < src_size)
+    {
+        const unsigned char token = src[ip++];
+
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && !ReadLength(src, src_size, ip, literal_length))
+            return false;
+
+        if (ip + literal_length > src_size || op + literal_length > dst_size)
+            return false;
+        memcpy(dst + op, src + ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+
+        // Note: The last sequence has no match
+        if (ip == src_size)
+            break;
+
+        if (ip + 2 > src_size)
+            return false;
+        const size_t offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+
+        size_t match_length = token & 15;
+        if (match_length == 15 && !ReadLength(src, src_size, ip, match_length))
+            return false;
+        match_length += MIN_MATCH;
+
+        if (offset == 0 || offset > op || op + match_length > dst_size)
+            return false;
+
+        // Note: The match is allowed to overlap the bytes it produces (offset < length repeats a pattern)
+        const unsigned char* match = dst + op - offset;
+        if (offset >= match_length)
+        {
+            memcpy(dst + op, match, match_length);
+        }
+        else
+        {
+            for (size_t i = 0; i < match_length; ++i)
+                dst[op + i] = match[i];
+        }
+        op += match_length;
+    }
+
+    return op == dst_size;
+}
@@ -0,0 +1,19 @@
+#ifndef LZ_H
+
+#include <cstddef>
+
+// A small, fast LZ77 codec producing the LZ4 block format (no frame), used for compressing the bricks of bricked
+// volumes. Compression is greedy with a single hash probe, decompression checks every read and write against the
+// buffer bounds so a corrupt file can't take the application down.
+
+// Worst case size of the compressed data, for incompressible input
+size_t LZCompressBound(size_t src_size);
+
+// Returns the size of the compressed data, 0 if it didn't fit in `dst_capacity`
+size_t LZCompress(const unsigned char* src, size_t src_size, unsigned char* dst, size_t dst_capacity);
+
+// Returns false if the compressed data is corrupt or doesn't decompress to exactly `dst_size` bytes
+bool LZDecompress(const unsigned char* src, size_t src_size, unsigned char* dst, size_t dst_size);
+
+#define LZ_H
+#endif
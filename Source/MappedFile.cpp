@@ -0,0 +1,68 @@
+#include "MappedFile.h"
+
+#include <sstream>
+
+MappedFile::MappedFile(const char* path, bool sequential)
+{
+    // Note: If we are going to walk through the file front to back, let the cache manager know so it can read ahead
+    // aggressively
+    const DWORD access_hint = sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | access_hint, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        std::ostringstream oss;
+        oss << "Unable to open file at path: " << path << std::endl;
+        OutputDebugStringA(oss.str().c_str());
+        return;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+    {
+        std::ostringstream oss;
+        oss << "Unable to get the size of (or empty) file at path: " << path << std::endl;
+        OutputDebugStringA(oss.str().c_str());
+        return;
+    }
+
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping)
+    {
+        std::ostringstream oss;
+        oss << "Unable to create file mapping for file at path: " << path << " (" << GetLastError() << ")" << std::endl;
+        OutputDebugStringA(oss.str().c_str());
+        return;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        std::ostringstream oss;
+        oss << "Unable to map view of file at path: " << path << " (" << GetLastError() << ")" << std::endl;
+        OutputDebugStringA(oss.str().c_str());
+        return;
+    }
+
+    data = (const unsigned char*)view;
+    size = (size_t)file_size.QuadPart;
+
+    // Kick off asynchronous read-in of the whole view, so that the consumer doesn't have to take a page fault
+    // every 4 KB and wait for the disk each time
+    if (sequential)
+    {
+        WIN32_MEMORY_RANGE_ENTRY range = { view, size };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (data)
+        UnmapViewOfFile(data);
+
+    if (mapping)
+        CloseHandle(mapping);
+
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+}
@@ -0,0 +1,31 @@
+#ifndef MAPPED_FILE_H
+
+#include "Core/Win32.h"
+
+#include <cstddef>
+
+// Read-only view of an entire file mapped into the address space of the process. The pages are brought in by the
+// OS on first access (straight out of the file cache), so the mapped data can be handed over to glTexImage3D or any
+// other CPU-side consumer without first copying it into a heap buffer of our own.
+struct MappedFile
+{
+    // Note: A sequential file is going to be read front to back, so the whole of it gets read ahead right away.
+    // Otherwise only the pages which are actually touched are ever read in.
+    MappedFile(const char* path, bool sequential = true);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    inline bool IsOpen() const { return data != nullptr; }
+
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+
+private:
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+};
+
+#define MAPPED_FILE_H
+#endif
@@ -0,0 +1,160 @@
+#include "MinMaxGrid.h"
+#include "ThreadPool.h"
+
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+MinMaxGrid::MinMaxGrid(const glm::ivec3& volume_dimensions, int brick_size)
+    : volume_dimensions(volume_dimensions), dimensions((volume_dimensions + brick_size - 1) / brick_size), brick_size(brick_size),
+    ranges((size_t)dimensions.x * dimensions.y * dimensions.z, glm::vec2(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()))
+{
+}
+
+// The bricks along an axis whose range takes in the voxel at `coordinate`, [x, y]
+static inline glm::ivec2 GetBricks(int coordinate, int size, int brick_size)
+{
+    return glm::ivec2(std::max(coordinate - 1, 0) / brick_size, std::min(coordinate + 1, size - 1) / brick_size);
+}
+
+// The range of the voxels of a row which fall into each brick along X, one past the faces included
+template <typename Read>
+static void GetRowRanges(const unsigned char* row, int width, int brick_size, unsigned int byte_count, glm::vec2* row_ranges, Read read)
+{
+    const int brick_count = (width + brick_size - 1) / brick_size;
+    for (int brick = 0; brick < brick_count; ++brick)
+    {
+        const int begin = std::max(brick * brick_size - 1, 0);
+        const int end = std::min((brick + 1) * brick_size + 1, width);
+
+        // Note: Comparisons with NaN are false, so NaNs never make it into the range
+        float min = std::numeric_limits<float>::max();
+        float max = std::numeric_limits<float>::lowest();
+        for (int x = begin; x < end; ++x)
+        {
+            const float value = read(row + x * byte_count);
+            if (value < min)
+                min = value;
+            if (value > max)
+                max = value;
+        }
+
+        row_ranges[brick] = glm::vec2(min, max);
+    }
+}
+
+template <typename T>
+static inline float ReadValue(const unsigned char* voxel)
+{
+    T value;
+    memcpy(&value, voxel, sizeof(value));
+    return (float)value;
+}
+
+static void GetRowRanges(const unsigned char* row, int width, int brick_size, VolumeDataType type, glm::vec2* row_ranges)
+{
+    const unsigned int byte_count = GetDataTypeSize(type);
+    switch (type)
+    {
+        case VolumeDataType::UINT8: GetRowRanges(row, width, brick_size, byte_count, row_ranges, ReadValue<uint8_t>); break;
+        case VolumeDataType::UINT16: GetRowRanges(row, width, brick_size, byte_count, row_ranges, ReadValue<uint16_t>); break;
+        case VolumeDataType::INT16: GetRowRanges(row, width, brick_size, byte_count, row_ranges, ReadValue<int16_t>); break;
+        case VolumeDataType::UINT32: GetRowRanges(row, width, brick_size, byte_count, row_ranges, ReadValue<uint32_t>); break;
+        case VolumeDataType::FLOAT32: GetRowRanges(row, width, brick_size, byte_count, row_ranges, ReadValue<float>); break;
+        case VolumeDataType::FLOAT16:
+        {
+            GetRowRanges(row, width, brick_size, byte_count, row_ranges, [](const unsigned char* voxel)
+            {
+                uint16_t value;
+                memcpy(&value, voxel, sizeof(value));
+                return glm::unpackHalf1x16(value);
+            });
+            break;
+        }
+    }
+}
+
+void MinMaxGrid::Accumulate(const unsigned char* voxels, int z_begin, int depth, VolumeDataType type)
+{
+    const size_t row_size = (size_t)volume_dimensions.x * GetDataTypeSize(type);
+    const size_t slice_size = row_size * volume_dimensions.y;
+    const int z_end = z_begin + depth;
+
+    // Note: Slices on the faces of a brick count towards the neighbouring brick too, so a layer of bricks reads the
+    // slices it shares with its neighbours again rather than writing to their bricks
+    const int first_layer = GetBricks(z_begin, volume_dimensions.z, brick_size).x;
+    const int last_layer = GetBricks(z_end - 1, volume_dimensions.z, brick_size).y;
+    ThreadPool::Get().ParallelFor(last_layer - first_layer + 1, [&](size_t layer_index)
+    {
+        const int layer = first_layer + (int)layer_index;
+        const int layer_begin = std::max(layer * brick_size - 1, z_begin);
+        const int layer_end = std::min((layer + 1) * brick_size + 1, z_end);
+
+        thread_local std::vector<glm::vec2> row_ranges;
+        row_ranges.resize(dimensions.x);
+        for (int z = layer_begin; z < layer_end; ++z)
+        {
+            for (int y = 0; y < volume_dimensions.y; ++y)
+            {
+                GetRowRanges(voxels + (z - z_begin) * slice_size + y * row_size, volume_dimensions.x, brick_size, type, row_ranges.data());
+
+                const glm::ivec2 bricks = GetBricks(y, volume_dimensions.y, brick_size);
+                for (int brick_y = bricks.x; brick_y <= bricks.y; ++brick_y)
+                {
+                    glm::vec2* brick_ranges = ranges.data() + ((size_t)layer * dimensions.y + brick_y) * dimensions.x;
+                    for (int brick_x = 0; brick_x < dimensions.x; ++brick_x)
+                    {
+                        brick_ranges[brick_x].x = std::min(brick_ranges[brick_x].x, row_ranges[brick_x].x);
+                        brick_ranges[brick_x].y = std::max(brick_ranges[brick_x].y, row_ranges[brick_x].y);
+                    }
+                }
+            }
+        }
+    });
+}
+
+void MinMaxGrid::GetOccupancy(const std::vector<unsigned char>& opacities, const glm::vec2& value_range, std::vector<unsigned char>& occupancy) const
+{
+    occupancy.resize(ranges.size());
+    const int texel_count = (int)opacities.size();
+    if (texel_count == 0)
+    {
+        std::fill(occupancy.begin(), occupancy.end(), (unsigned char)0);
+        return;
+    }
+
+    // Number of visible texels up to each texel, so any range of the transfer function can be checked in constant time
+    std::vector<int> visible_count(texel_count + 1, 0);
+    for (int i = 0; i < texel_count; ++i)
+        visible_count[i + 1] = visible_count[i] + (opacities[i] > 0);
+
+    const float extent = value_range.y - value_range.x;
+    auto get_texel = [&](float value)
+    {
+        const float position = (extent > 0.f) ? std::clamp((value - value_range.x) / extent, 0.f, 1.f) : 0.f;
+        return position * texel_count - 0.5f;
+    };
+
+    ThreadPool::Get().ParallelFor(dimensions.z, [&](size_t z)
+    {
+        const size_t layer_size = (size_t)dimensions.x * dimensions.y;
+        for (size_t i = z * layer_size; i < (z + 1) * layer_size; ++i)
+        {
+            const glm::vec2& range = ranges[i];
+            if (range.x > range.y)
+            {
+                occupancy[i] = 1;
+                continue;
+            }
+
+            // Note: Linear filtering blends the two texels around a position, and one more texel on either side
+            // leaves room for rounding (float16 textures round the voxels the range was taken from)
+            const int first = std::clamp((int)std::floor(get_texel(range.x)) - 1, 0, texel_count - 1);
+            const int last = std::clamp((int)std::ceil(get_texel(range.y)) + 1, 0, texel_count - 1);
+            occupancy[i] = (visible_count[last + 1] - visible_count[first]) > 0;
+        }
+    });
+}
@@ -0,0 +1,37 @@
+#ifndef MIN_MAX_GRID_H
+
+#include "Volume.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Smallest and largest value of every brick of `brick_size`^3 voxels of a volume texture, for skipping over the bricks
+// the transfer function makes fully transparent.
+//
+// Note: A brick's range takes in the voxels one past its faces as well, since those are what trilinear filtering pulls
+// in for samples within the brick. So a brick which comes out empty is empty for every sample within it.
+struct MinMaxGrid
+{
+    MinMaxGrid() = default;
+    MinMaxGrid(const glm::ivec3& volume_dimensions, int brick_size = 8);
+
+    // Adds the (little endian) slices [z_begin, z_begin + depth) of the volume, in any order. The bricks are spread
+    // over the thread pool by Z, so no two threads ever touch the same brick.
+    void Accumulate(const unsigned char* voxels, int z_begin, int depth, VolumeDataType type);
+
+    // One byte per brick, 1 if any value within the brick maps to a non-zero opacity of the transfer function. The
+    // values map to the transfer function the same way they do in the shader, [value_range.x, value_range.y] to [0, 1]
+    // clamped, and `opacities` holds the alpha of its texels.
+    // Note: Bricks with only NaNs in them are kept, there's no telling what the shader makes of those
+    void GetOccupancy(const std::vector<unsigned char>& opacities, const glm::vec2& value_range, std::vector<unsigned char>& occupancy) const;
+
+    glm::ivec3 volume_dimensions = glm::ivec3(0);
+    glm::ivec3 dimensions = glm::ivec3(0);
+    int brick_size = 8;
+
+    // X-major like the volume, empty ranges (x > y) for bricks which haven't seen a value yet
+    std::vector<glm::vec2> ranges;
+};
+
+#define MIN_MAX_GRID_H
+#endif
@@ -0,0 +1,71 @@
+#include "MortonVolume.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+MortonVolume::MortonVolume(const glm::ivec3& dimensions, const unsigned char* voxels, VolumeDataType type, float scale, float bias)
+    : dimensions(dimensions), brick_count((dimensions + MORTON_BRICK_SIZE - 1) / MORTON_BRICK_SIZE)
+{
+    const size_t brick_volume = MORTON_BRICK_SIZE * MORTON_BRICK_SIZE * MORTON_BRICK_SIZE;
+    brick_strides[0] = brick_volume;
+    brick_strides[1] = brick_volume * brick_count.x;
+    brick_strides[2] = brick_volume * brick_count.x * brick_count.y;
+    values.resize(brick_strides[2] * brick_count.z);
+
+    // Note: A row of bricks reads MORTON_BRICK_SIZE whole rows of the source from as many slices, so every thread
+    // streams through the source in order
+    const unsigned int byte_count = GetDataTypeSize(type);
+    const size_t row_size = (size_t)dimensions.x * byte_count;
+    const size_t slice_size = row_size * dimensions.y;
+    ThreadPool::Get().ParallelFor((size_t)brick_count.y * brick_count.z, [&](size_t brick_row)
+    {
+        const int y_begin = (int)(brick_row % brick_count.y) * MORTON_BRICK_SIZE;
+        const int z_begin = (int)(brick_row / brick_count.y) * MORTON_BRICK_SIZE;
+        for (int z = z_begin; z < z_begin + MORTON_BRICK_SIZE; ++z)
+        {
+            const unsigned char* slice = voxels + std::min(z, dimensions.z - 1) * slice_size;
+            const size_t z_offset = GetOffset(2, z);
+            for (int y = y_begin; y < y_begin + MORTON_BRICK_SIZE; ++y)
+            {
+                const unsigned char* row = slice + std::min(y, dimensions.y - 1) * row_size;
+                const size_t yz_offset = z_offset + GetOffset(1, y);
+                for (int x = 0; x < brick_count.x * MORTON_BRICK_SIZE; ++x)
+                {
+                    const float value = GetVoxelValue(row + std::min(x, dimensions.x - 1) * byte_count, type);
+                    values[yz_offset + GetOffset(0, x)] = value * scale + bias;
+                }
+            }
+        }
+    });
+}
+
+float MortonVolume::Sample(const glm::vec3& position) const
+{
+    const glm::vec3 texel_position = position * glm::vec3(dimensions) - 0.5f;
+    const glm::vec3 base = glm::floor(texel_position);
+    const glm::vec3 f = texel_position - base;
+
+    const glm::ivec3 max_texel = dimensions - 1;
+    const glm::ivec3 p0 = glm::clamp(glm::ivec3(base), glm::ivec3(0), max_texel);
+    const glm::ivec3 p1 = glm::clamp(glm::ivec3(base) + 1, glm::ivec3(0), max_texel);
+
+    const size_t x0 = GetOffset(0, p0.x), x1 = GetOffset(0, p1.x);
+    const size_t y0 = GetOffset(1, p0.y), y1 = GetOffset(1, p1.y);
+    const float* s0 = values.data() + GetOffset(2, p0.z);
+    const float* s1 = values.data() + GetOffset(2, p1.z);
+
+    const float c000 = s0[y0 + x0], c100 = s0[y0 + x1];
+    const float c010 = s0[y1 + x0], c110 = s0[y1 + x1];
+    const float c001 = s1[y0 + x0], c101 = s1[y0 + x1];
+    const float c011 = s1[y1 + x0], c111 = s1[y1 + x1];
+
+    const float c00 = c000 + (c100 - c000) * f.x;
+    const float c10 = c010 + (c110 - c010) * f.x;
+    const float c01 = c001 + (c101 - c001) * f.x;
+    const float c11 = c011 + (c111 - c011) * f.x;
+
+    const float c0 = c00 + (c10 - c00) * f.y;
+    const float c1 = c01 + (c11 - c01) * f.y;
+    return c0 + (c1 - c0) * f.z;
+}
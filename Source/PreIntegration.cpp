@@ -0,0 +1,135 @@
+#include "PreIntegration.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+PreIntegrationTable::PreIntegrationTable()
+{
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+PreIntegrationTable::~PreIntegrationTable()
+{
+    if (worker.joinable())
+        worker.join();
+
+    glDeleteTextures(1, &texture);
+}
+
+void PreIntegrationTable::Rebuild(const std::vector<uint8_t>& colormap, float segment_length)
+{
+    requested_colormap = colormap;
+    requested_segment_length = segment_length;
+    has_request = true;
+}
+
+bool PreIntegrationTable::Update()
+{
+    if (building)
+        return false;
+
+    bool uploaded = false;
+    if (worker.joinable())
+    {
+        worker.join();
+
+        const GLsizei texel_count = (GLsizei)(built_colormap.size() / 4);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, texel_count, texel_count, 0, GL_RGBA, GL_FLOAT, table.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        uploaded_segment_length = built_segment_length;
+        uploaded = true;
+    }
+
+    if (has_request)
+    {
+        has_request = false;
+        building = true;
+        worker = std::thread(&PreIntegrationTable::Build, this, std::move(requested_colormap), requested_segment_length);
+    }
+
+    return uploaded;
+}
+
+// Composites the segment front to back in steps of one texel, with the transfer function interpolated linearly in
+// between texels the way the sampler does it
+static glm::vec4 IntegrateSegment(const std::vector<glm::vec4>& texels, int front, int back, float segment_length)
+{
+    const int texel_count = (int)texels.size();
+    const int step_count = std::abs(back - front) + 1;
+    const float step_length = segment_length / (float)step_count;
+
+    glm::vec4 result(0.f);
+    for (int step = 0; step < step_count; ++step)
+    {
+        const float position = front + (back - front) * (step + 0.5f) / (float)step_count;
+        const int texel = std::min((int)position, texel_count - 1);
+        const glm::vec4 color = glm::mix(texels[texel], texels[std::min(texel + 1, texel_count - 1)], position - (float)texel);
+
+        // Note: The same opacity correction the shader applies to single samples
+        const float alpha = 1.f - std::pow(std::max(1.f - color.a, 0.f), step_length);
+        result += (1.f - result.a) * glm::vec4(alpha * glm::vec3(color), alpha);
+    }
+
+    return result;
+}
+
+void PreIntegrationTable::Build(std::vector<uint8_t> colormap, float segment_length)
+{
+    const int texel_count = (int)(colormap.size() / 4);
+
+    // The texels which differ from the previous build, everything if the layout or the segment length changed
+    int dirty_begin = 0;
+    int dirty_end = texel_count;
+    if (colormap.size() == built_colormap.size() && segment_length == built_segment_length)
+    {
+        dirty_begin = texel_count;
+        dirty_end = 0;
+        for (int i = 0; i < texel_count; ++i)
+        {
+            if (!std::equal(colormap.begin() + i * 4, colormap.begin() + i * 4 + 4, built_colormap.begin() + i * 4))
+            {
+                dirty_begin = std::min(dirty_begin, i);
+                dirty_end = i + 1;
+            }
+        }
+    }
+    else
+    {
+        table.assign((size_t)texel_count * texel_count, glm::vec4(0.f));
+    }
+
+    if (dirty_begin < dirty_end)
+    {
+        std::vector<glm::vec4> texels(texel_count);
+        for (int i = 0; i < texel_count; ++i)
+            texels[i] = glm::vec4(colormap[i * 4], colormap[i * 4 + 1], colormap[i * 4 + 2], colormap[i * 4 + 3]) / 255.f;
+
+        // Note: A segment only ever looks at the texels between its front and back, so only those spanning a dirty
+        // texel have to be recomputed. Rows are indexed by the back of the segment, columns by its front.
+        ThreadPool::Get().ParallelFor(texel_count, [&](size_t back)
+        {
+            for (int front = 0; front < texel_count; ++front)
+            {
+                if (std::max(front, (int)back) < dirty_begin || std::min(front, (int)back) >= dirty_end)
+                    continue;
+
+                table[back * texel_count + front] = IntegrateSegment(texels, front, (int)back, segment_length);
+            }
+        });
+    }
+
+    built_colormap = std::move(colormap);
+    built_segment_length = segment_length;
+    building = false;
+}
@@ -0,0 +1,65 @@
+#ifndef PRE_INTEGRATION_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Pre-integrated transfer function: a 2D table of the colour (premultiplied) and opacity of a ray segment, indexed by
+// the transfer function positions of the samples at its front and back. The values in between are taken to vary
+// linearly along the segment, so sharp peaks of the transfer function show up even when both samples miss them, which
+// is what lets the ray marcher get away with low sampling rates.
+//
+// The table only holds for segments of one length (in units of the reference sampling interval), the shader corrects
+// the opacity for segments of any other length.
+//
+// Note: Builds run on a worker thread of their own, with the rows spread over the thread pool. Only the entries whose
+// segments span a texel which differs from the previous build are recomputed, so dragging a control point of the
+// transfer function only rebuilds the part of the table around it.
+struct PreIntegrationTable
+{
+    PreIntegrationTable();
+    ~PreIntegrationTable();
+
+    PreIntegrationTable(const PreIntegrationTable&) = delete;
+    PreIntegrationTable& operator=(const PreIntegrationTable&) = delete;
+
+    // Requests a table for `colormap` (RGBA8 texels, as TransferFunctionWidget hands them out). Only one build is in
+    // flight at a time, a request made during it replaces whichever one is waiting.
+    void Rebuild(const std::vector<uint8_t>& colormap, float segment_length);
+
+    // Uploads the table once its build is done and kicks off the waiting request, if any. Call once per frame on the
+    // thread which owns the OpenGL context. Returns true if a new table was uploaded.
+    bool Update();
+
+    // True once a table has been uploaded, until then there is nothing to sample
+    inline bool IsReady() const { return uploaded_segment_length > 0.f; }
+
+    // True while a table is being built or waiting to be uploaded, Update() has to keep being called until it isn't
+    inline bool IsBuilding() const { return has_request || worker.joinable(); }
+
+    GLuint texture;
+
+    // The segment length of the table in the texture
+    float uploaded_segment_length = 0.f;
+
+private:
+    void Build(std::vector<uint8_t> colormap, float segment_length);
+
+    std::thread worker;
+    std::atomic<bool> building = false;
+
+    // Note: Only touched by the worker while `building` is set, and by the render thread otherwise
+    std::vector<uint8_t> built_colormap;
+    float built_segment_length = 0.f;
+    std::vector<glm::vec4> table;
+
+    bool has_request = false;
+    std::vector<uint8_t> requested_colormap;
+    float requested_segment_length = 0.f;
+};
+
+#define PRE_INTEGRATION_H
+#endif
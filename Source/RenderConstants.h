@@ -0,0 +1,12 @@
+#ifndef RENDER_CONSTANTS_H
+
+// Constants the renderers (the ray casters on the GPU and the CPU, and shear-warp) have to agree on
+
+// The sampling interval, in samples per unit of the volume, which the opacities of the transfer function are given
+// for. Samples further apart (or closer together) have their opacity corrected against it.
+//
+// Note: Shaders/RayMarching.glsl has its own copy, which has to match
+#define REF_SAMPLING_INTERVAL 150.f
+
+#define RENDER_CONSTANTS_H
+#endif
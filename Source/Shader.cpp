@@ -23,6 +23,20 @@ Shader::Shader(const char* vertex_shader_path, const char* fragment_shader_path)
     glDeleteShader(fragment_shader);
 }
 
+Shader::Shader(const char* compute_shader_path)
+{
+    GLuint compute_shader = ReadShader(compute_shader_path, ShaderType::COMPUTE);
+
+    id = glCreateProgram();
+    glAttachShader(id, compute_shader);
+
+    glLinkProgram(id);
+
+    CheckErrors(id, ShaderType::PROGRAM);
+
+    glDeleteShader(compute_shader);
+}
+
 void Shader::SetUniform1i(const char* name, int v)
 {
     glUniform1i(GetUniformLocation(name), v);
@@ -38,6 +52,11 @@ void Shader::SetUniform1f(const char* name, float val)
     glUniform1f(GetUniformLocation(name), val);
 }
 
+void Shader::SetUniform2f(const char* name, float v0, float v1)
+{
+    glUniform2f(GetUniformLocation(name), v0, v1);
+}
+
 void Shader::SetUniform3f(const char* name, float v0, float v1, float v2)
 {
     glUniform3f(GetUniformLocation(name), v0, v1, v2);
@@ -65,36 +84,86 @@ GLint Shader::GetUniformLocation(const char* name)
     return location;
 }
 
-GLuint Shader::ReadShader(const char* shader_path, ShaderType type) const
+static const char* GetShaderTypeName(GLenum type)
 {
-    GLuint shader;
-    std::ifstream in_file(shader_path);
-    if (in_file.is_open())
+    switch (type)
     {
-        std::stringstream shader_buffer;
-        shader_buffer << in_file.rdbuf();
-        const std::string& shader_code = shader_buffer.str();
-        const char* shader_source = shader_code.c_str();
+        case GL_VERTEX_SHADER: return "vertex";
+        case GL_FRAGMENT_SHADER: return "fragment";
+        case GL_COMPUTE_SHADER: return "compute";
+    }
 
-        shader = glCreateShader(type == ShaderType::VERTEX ? GL_VERTEX_SHADER : GL_FRAGMENT_SHADER);
-        glShaderSource(shader, 1, &shader_source, NULL);
-        glCompileShader(shader);
+    return "unknown";
+}
 
-        CheckErrors(shader, type);
-    }
-    else
+GLuint Shader::ReadShader(const char* shader_path, ShaderType type) const
+{
+    GLenum shader_type = GL_VERTEX_SHADER;
+    if (type == ShaderType::FRAGMENT)
+        shader_type = GL_FRAGMENT_SHADER;
+    else if (type == ShaderType::COMPUTE)
+        shader_type = GL_COMPUTE_SHADER;
+
+    std::string shader_code;
+    if (!ReadShaderSource(shader_path, shader_code))
     {
         std::ostringstream oss;
-        const char* shader_type = (type == ShaderType::VERTEX) ? "vertex" : "fragment";
-        oss << "Unable to open " << shader_type << " shader file at path " << shader_path << std::endl;
+        oss << "Unable to read " << GetShaderTypeName(shader_type) << " shader file at path " << shader_path << std::endl;
         OutputDebugStringA(oss.str().c_str());
         exit(1);
     }
-    in_file.close();
+
+    const char* shader_source = shader_code.c_str();
+
+    GLuint shader = glCreateShader(shader_type);
+    glShaderSource(shader, 1, &shader_source, NULL);
+    glCompileShader(shader);
+
+    CheckErrors(shader, type);
 
     return shader;
 }
 
+// Reads the file with every #include "file" line replaced by the contents of that file
+bool Shader::ReadShaderSource(const std::filesystem::path& shader_path, std::string& source, int depth) const
+{
+    // Note: Guards against files including each other
+    if (depth > 16)
+        return false;
+
+    std::ifstream in_file(shader_path);
+    if (!in_file.is_open())
+        return false;
+
+    std::string line;
+    while (std::getline(in_file, line))
+    {
+        const size_t directive = line.find_first_not_of(" \t");
+        if (directive != std::string::npos && line.compare(directive, 8, "#include") == 0)
+        {
+            const size_t name_begin = line.find('"', directive);
+            const size_t name_end = (name_begin != std::string::npos) ? line.find('"', name_begin + 1) : std::string::npos;
+            if (name_end == std::string::npos)
+                return false;
+
+            const std::filesystem::path include_path = shader_path.parent_path() / line.substr(name_begin + 1, name_end - name_begin - 1);
+            if (!ReadShaderSource(include_path, source, depth + 1))
+            {
+                std::ostringstream oss;
+                oss << "Unable to include " << include_path.string() << " in " << shader_path.string() << std::endl;
+                OutputDebugStringA(oss.str().c_str());
+                return false;
+            }
+            continue;
+        }
+
+        source += line;
+        source += '\n';
+    }
+
+    return true;
+}
+
 void Shader::CheckErrors(GLuint shader, ShaderType type) const
 {
     GLint success;
@@ -104,15 +173,17 @@ void Shader::CheckErrors(GLuint shader, ShaderType type) const
     {
         case ShaderType::VERTEX:
         case ShaderType::FRAGMENT:
+        case ShaderType::COMPUTE:
         {
             glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
             if (!success)
             {
                 glGetShaderInfoLog(shader, 1024, NULL, info_log);
 
-                const char* shader_type = (type == ShaderType::VERTEX) ? "vertex" : "fragment";
+                GLint shader_type;
+                glGetShaderiv(shader, GL_SHADER_TYPE, &shader_type);
                 std::ostringstream oss;
-                oss << "OpenGL Error: Failed to compile " << shader_type << " shader!" <<  std::endl << info_log;
+                oss << "OpenGL Error: Failed to compile " << GetShaderTypeName(shader_type) << " shader!" <<  std::endl << info_log;
                 OutputDebugStringA(oss.str().c_str());
                 exit(1);
             }
@@ -1,16 +1,20 @@
 #ifndef SHADER_H
 
+#include <filesystem>
 #include <string>
 #include <unordered_map>
 #include <glad/glad.h>
 
+// Note: Shader sources can pull in other files with #include "file", relative to the file including them
 struct Shader
 {
     Shader(const char* vertex_shader_path, const char* fragment_shader_path);
+    explicit Shader(const char* compute_shader_path);
 
     void SetUniform1i(const char* name, int v);
     void SetUniform3i(const char* name, int v0, int v1, int v2);
     void SetUniform1f(const char* name, float val);
+    void SetUniform2f(const char* name, float v0, float v1);
     void SetUniform3f(const char* name, float v0, float v1, float v2);
     void SetUniformMatrix4fv(const char* name, float* v);
 
@@ -24,11 +28,13 @@ private:
     {
         VERTEX,
         FRAGMENT,
+        COMPUTE,
         PROGRAM
     };
 
     GLint GetUniformLocation(const char* name);
     GLuint ReadShader(const char* shader_path, ShaderType type) const;
+    bool ReadShaderSource(const std::filesystem::path& shader_path, std::string& source, int depth = 0) const;
     void CheckErrors(GLuint shader, ShaderType type) const;
 
     GLuint id;
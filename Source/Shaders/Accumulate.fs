@@ -0,0 +1,12 @@
+#version 330 core
+
+layout (location = 0) out vec4 out_frag_color;
+
+// Note: The frame is blended into the accumulation image with a constant weight of 1 / (frames so far + 1), which keeps
+// the image the average of every frame accumulated into it
+uniform sampler2D frame;
+
+void main()
+{
+    out_frag_color = texelFetch(frame, ivec2(gl_FragCoord.xy), 0);
+}
@@ -0,0 +1,293 @@
+// Ray setup, sampling and compositing of the ray casters, shared by Shader.fs and RayCaster.comp
+// Note: Pulled in with #include (see Shader::ReadShader), so it has no #version of its own
+
+uniform sampler2D entry_points_sampler;
+uniform sampler2D exit_points_sampler;
+
+// Note: With analytic_rays set the rays are intersected with the volume here instead of being read from the entry and
+// exit points. inverse_pvm takes clip space back to the [0, 1] space of the volume.
+uniform bool analytic_rays;
+uniform mat4 inverse_pvm;
+
+uniform sampler3D volume;
+uniform usampler3D integer_volume;
+uniform bool is_integer_volume;
+uniform sampler1D transfer_function;
+
+// Colour (premultiplied) and opacity of the segment between two samples, indexed by their values, for segments
+// preintegration_length reference sampling intervals long
+uniform sampler2D preintegrated_transfer_function;
+uniform float preintegration_length;
+uniform bool pre_integrated;
+uniform ivec3 volume_dims;
+
+// Maps the sampled value to the [0, 1] range of the transfer function, val = sample * value_scale + value_bias
+uniform float value_scale;
+uniform float value_bias;
+
+uniform float sampling_rate;
+
+// Mip level the volume is sampled at, above 0 when the samples are further apart than the voxels
+uniform float volume_lod;
+
+// Size of the target the rays are cast into, in pixels
+uniform vec2 viewport_size;
+
+// One texel per brick of brick_size^3 voxels, non-zero if the transfer function makes anything within it visible
+uniform sampler3D occupancy;
+uniform int brick_size;
+uniform bool skip_empty_space;
+
+// Note: With jitter_rays set every pixel starts its ray at a different fraction of the sampling interval, which turns
+// the banding of low sampling rates into noise. frame_index moves the offsets on from frame to frame so that averaging
+// frames fills in between the samples.
+uniform bool jitter_rays;
+uniform int frame_index;
+
+// Note: A copy of REF_SAMPLING_INTERVAL in RenderConstants.h, which has to match
+#define REF_SAMPLING_INTERVAL 150.0
+
+// Where the first sample lies within the sampling interval, in [0, 1), set per ray with GetSampleOffset
+float sample_offset = 0.5;
+
+// Interleaved gradient noise over the pixels, shifted by the golden ratio every frame so that the offsets of a pixel
+// spread evenly over the interval as frames go by
+float GetSampleOffset(vec2 pixel)
+{
+    if (!jitter_rays)
+        return 0.5;
+
+    vec2 p = floor(pixel);
+    float noise = fract(52.9829189 * fract(dot(p, vec2(0.06711056, 0.00583715))));
+    return fract(noise + 0.61803398875 * float(frame_index % 4096));
+}
+
+// Integer textures can't be filtered by the hardware, so they are filtered here
+float SampleIntegerVolume(vec3 pos)
+{
+    vec3 texel_pos = pos * vec3(volume_dims) - 0.5;
+    ivec3 base = ivec3(floor(texel_pos));
+    vec3 f = texel_pos - vec3(base);
+
+    ivec3 max_texel = volume_dims - 1;
+    ivec3 p0 = clamp(base, ivec3(0), max_texel);
+    ivec3 p1 = clamp(base + 1, ivec3(0), max_texel);
+
+    float c000 = float(texelFetch(integer_volume, ivec3(p0.x, p0.y, p0.z), 0).r);
+    float c100 = float(texelFetch(integer_volume, ivec3(p1.x, p0.y, p0.z), 0).r);
+    float c010 = float(texelFetch(integer_volume, ivec3(p0.x, p1.y, p0.z), 0).r);
+    float c110 = float(texelFetch(integer_volume, ivec3(p1.x, p1.y, p0.z), 0).r);
+    float c001 = float(texelFetch(integer_volume, ivec3(p0.x, p0.y, p1.z), 0).r);
+    float c101 = float(texelFetch(integer_volume, ivec3(p1.x, p0.y, p1.z), 0).r);
+    float c011 = float(texelFetch(integer_volume, ivec3(p0.x, p1.y, p1.z), 0).r);
+    float c111 = float(texelFetch(integer_volume, ivec3(p1.x, p1.y, p1.z), 0).r);
+
+    float c00 = mix(c000, c100, f.x);
+    float c10 = mix(c010, c110, f.x);
+    float c01 = mix(c001, c101, f.x);
+    float c11 = mix(c011, c111, f.x);
+
+    return mix(mix(c00, c10, f.y), mix(c01, c11, f.y), f.z);
+}
+
+float SampleVolume(vec3 pos)
+{
+    float val = is_integer_volume ? SampleIntegerVolume(pos) : textureLod(volume, pos, volume_lod).r;
+    return clamp(val * value_scale + value_bias, 0.0, 1.0);
+}
+
+vec4 GetSampleColor(float val, float dt)
+{
+    vec4 color = texture(transfer_function, val);
+
+    // Opacity correction
+    color.a = 1.0 - pow(1.0 - color.a, dt * REF_SAMPLING_INTERVAL);
+    return vec4(color.rgb * color.a, color.a);
+}
+
+vec4 GetSegmentColor(float front_val, float back_val, float dt)
+{
+    vec4 color = texture(preintegrated_transfer_function, vec2(front_val, back_val));
+
+    // Note: The table holds for segments of one length only, other lengths are corrected like single samples are
+    float alpha = 1.0 - pow(max(1.0 - color.a, 0.0), dt * REF_SAMPLING_INTERVAL / preintegration_length);
+    return vec4(color.rgb * ((color.a > 0.0) ? alpha / color.a : 0.0), alpha);
+}
+
+// Distance along the ray from `origin` to where it leaves the brick
+float GetBrickExit(ivec3 brick, vec3 origin, vec3 direction)
+{
+    vec3 box_min = vec3(brick * brick_size) / vec3(volume_dims);
+    vec3 box_max = vec3(min((brick + 1) * brick_size, volume_dims)) / vec3(volume_dims);
+
+    // Note: Axis parallel rays would divide by zero
+    direction = mix(direction, vec3(1e-8), lessThan(abs(direction), vec3(1e-8)));
+    vec3 t_far = max((box_min - origin) / direction, (box_max - origin) / direction);
+    return min(t_far.x, min(t_far.y, t_far.z));
+}
+
+// Distance between the samples of the ray from `entry_point` to `exit_point`
+float GetSamplingInterval(vec3 entry_point, vec3 exit_point)
+{
+    vec3 ray_direction = exit_point - entry_point;
+    float t_end = length(ray_direction);
+    return min(t_end, t_end / (sampling_rate * length(ray_direction * volume_dims)));
+}
+
+// Finds the first sample of the ray which lies in a visible brick, jumping over the empty ones exactly the way
+// RayTraversal does. False if there is none.
+bool FindFirstVisibleSample(vec3 entry_point, vec3 exit_point, out int first_sample)
+{
+    vec3 ray_direction = exit_point - entry_point;
+    float t_end = length(ray_direction);
+    float dt = GetSamplingInterval(entry_point, exit_point);
+
+    ray_direction = normalize(ray_direction);
+    ivec3 max_brick = textureSize(occupancy, 0) - 1;
+
+    int i = 0;
+    while ((float(i) + sample_offset) * dt < t_end)
+    {
+        float t = (float(i) + sample_offset) * dt;
+        vec3 sample_pos = entry_point + t * ray_direction;
+
+        ivec3 brick = clamp(ivec3(sample_pos * vec3(volume_dims)) / brick_size, ivec3(0), max_brick);
+        if (texelFetch(occupancy, brick, 0).r != 0.0)
+        {
+            first_sample = i;
+            return true;
+        }
+
+        float t_exit = GetBrickExit(brick, entry_point, ray_direction);
+        i = max(i + 1, int(floor(t_exit / dt - sample_offset)) + 1);
+    }
+
+    first_sample = i;
+    return false;
+}
+
+// Number of times the volume was sampled by RayTraversal, summed over every call
+int samples_taken = 0;
+
+// Composites the samples of the ray front to back, from `first_sample` on. Starting past the samples in empty bricks
+// (see FindFirstVisibleSample) gives the same result as starting from 0, those samples don't add anything.
+vec4 RayTraversal(vec3 entry_point, vec3 exit_point, int first_sample)
+{
+    vec4 result = vec4(0.0);
+    vec3 ray_direction = exit_point - entry_point;
+    float t_end = length(ray_direction);
+    float dt = GetSamplingInterval(entry_point, exit_point);
+
+    ray_direction = normalize(ray_direction);
+    ivec3 max_brick = textureSize(occupancy, 0) - 1;
+    vec3 sample_pos;
+
+    // Note: Sample positions are computed from their index rather than accumulated, so skipping empty bricks lands
+    // on exactly the samples which would have been taken anyway
+    int i = first_sample;
+    float front_val = 0.0;
+    bool has_front = false;
+    while ((float(i) + sample_offset) * dt < t_end)
+    {
+        float t = (float(i) + sample_offset) * dt;
+        sample_pos = entry_point + t * ray_direction;
+
+        ivec3 brick = clamp(ivec3(sample_pos * vec3(volume_dims)) / brick_size, ivec3(0), max_brick);
+        bool empty = skip_empty_space && texelFetch(occupancy, brick, 0).r == 0.0;
+
+        // Note: With pre-integration the segment leading into an empty brick can still start in a visible one, so it
+        // is taken before jumping
+        if (!empty || pre_integrated)
+        {
+            // val ranges from 0 to 1
+            float val = SampleVolume(sample_pos);
+            ++samples_taken;
+            vec4 val_color;
+            if (pre_integrated)
+            {
+                // The previous sample isn't known after a jump, it is taken again (at the entry point for the first one)
+                if (!has_front)
+                {
+                    front_val = SampleVolume(entry_point + max((float(i) - 1.0 + sample_offset) * dt, 0.0) * ray_direction);
+                    ++samples_taken;
+                }
+
+                val_color = GetSegmentColor(front_val, val, dt);
+                front_val = val;
+                has_front = true;
+            }
+            else
+            {
+                val_color = GetSampleColor(val, dt);
+            }
+
+            result.rgb += (1.f - result.a) * val_color.rgb;
+            result.a += (1.f - result.a) * val_color.a;
+
+            if (result.a >= 0.99f)
+                break;
+        }
+
+        if (empty)
+        {
+            // Jump to the first sample past the brick, every segment up to it is fully transparent
+            float t_exit = GetBrickExit(brick, entry_point, ray_direction);
+            i = max(i + 1, int(floor(t_exit / dt - sample_offset)) + 1);
+            has_front = false;
+            continue;
+        }
+
+        ++i;
+    }
+
+    return result;
+}
+
+// Intersects the ray through `pixel` of a `size` target with the [0, 1] box of the volume, from the near (or the camera
+// within the volume) to the far end of it. Rays which miss it come out with the entry point equal to the exit point.
+void GetRay(vec2 pixel, vec2 size, out vec3 entry_point, out vec3 exit_point)
+{
+    if (!analytic_rays)
+    {
+        // Note: The entry and exit points are always at full resolution, when rendering at a lower one every pixel
+        // takes the ray of the texel it falls on. Filtering them would blend rays across the silhouette of the volume.
+        ivec2 texel = ivec2(pixel * (vec2(textureSize(entry_points_sampler, 0)) / size));
+        entry_point = texelFetch(entry_points_sampler, texel, 0).rgb;
+        exit_point = texelFetch(exit_points_sampler, texel, 0).rgb;
+        return;
+    }
+
+    vec2 ndc = pixel / size * 2.0 - 1.0;
+    vec4 near = inverse_pvm * vec4(ndc, -1.0, 1.0);
+    vec4 far = inverse_pvm * vec4(ndc, 1.0, 1.0);
+    vec3 origin = near.xyz / near.w;
+    vec3 direction = far.xyz / far.w - origin;
+
+    // Slab test, t runs from the near plane (0) to the far plane (1), so with the camera within the volume the ray starts
+    // at the near plane
+    vec3 t0 = (vec3(0.0) - origin) / direction;
+    vec3 t1 = (vec3(1.0) - origin) / direction;
+    vec3 t_min = min(t0, t1);
+    vec3 t_max = max(t0, t1);
+    float t_entry = max(max(max(t_min.x, t_min.y), t_min.z), 0.0);
+    float t_exit = min(min(min(t_max.x, t_max.y), t_max.z), 1.0);
+
+    entry_point = vec3(0.0);
+    exit_point = vec3(0.0);
+    if (t_entry < t_exit)
+    {
+        entry_point = clamp(origin + t_entry * direction, 0.0, 1.0);
+        exit_point = clamp(origin + t_exit * direction, 0.0, 1.0);
+    }
+}
+
+// Composites the colour of a ray over the background
+vec4 BlendBackground(vec4 color)
+{
+    vec4 bg_color = vec4(0.5f, 0.5f, 0.5f, 1.f);
+
+    vec4 result;
+    result.a = color.a + bg_color.a - color.a * bg_color.a;
+    result.rgb = bg_color.a * bg_color.rgb * (1.0  - color.a) + color.rgb * color.a;
+    return result;
+}
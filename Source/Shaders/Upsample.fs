@@ -0,0 +1,70 @@
+#version 330 core
+
+layout (location = 0) out vec4 out_frag_color;
+
+// The image ray cast at a reduced resolution, in the lower left corner of the texture
+uniform sampler2D low_resolution_image;
+uniform vec2 low_resolution_size;
+
+// Note: The rays of the pixels guide the upsampling, they are set up with the same GetRay (and uniforms) the ray
+// caster uses, viewport_size being the size of the full resolution image
+#include "RayMarching.glsl"
+
+// How far apart (in volume space) the rays of two pixels can be before they stop blending into each other
+#define GUIDE_SIGMA 0.02
+
+// The entry point and length of the ray through a pixel of a `size` target, rays which miss the volume have a length of 0
+vec4 GetGuide(vec2 pixel, vec2 size)
+{
+    vec3 entry_point, exit_point;
+    GetRay(pixel, size, entry_point, exit_point);
+    return vec4(entry_point, distance(entry_point, exit_point));
+}
+
+// Joint bilateral upsampling: the four low resolution pixels around this one are weighed bilinearly, and by how
+// similar their rays are to the ray of this pixel. That keeps the silhouette of the volume from bleeding into the
+// background and the background into it.
+void main()
+{
+    vec2 scale = viewport_size / low_resolution_size;
+
+    vec4 guide = GetGuide(gl_FragCoord.xy, viewport_size);
+
+    vec2 position = gl_FragCoord.xy / scale - 0.5;
+    ivec2 base = ivec2(floor(position));
+    vec2 f = position - vec2(base);
+
+    vec4 color_sum = vec4(0.0);
+    float weight_sum = 0.0;
+
+    // Note: Falls back to the most similar neighbour where none of them is similar enough to blend
+    vec4 closest_color = vec4(0.0);
+    float closest_distance = 1e30;
+
+    for (int y = 0; y < 2; ++y)
+    {
+        for (int x = 0; x < 2; ++x)
+        {
+            ivec2 low_texel = clamp(base + ivec2(x, y), ivec2(0), ivec2(low_resolution_size) - 1);
+
+            // Note: The same ray the ray caster used for this pixel
+            vec4 difference = GetGuide(vec2(low_texel) + 0.5, low_resolution_size) - guide;
+            float guide_distance = dot(difference, difference);
+
+            vec4 color = texelFetch(low_resolution_image, low_texel, 0);
+            float bilinear = (x == 1 ? f.x : 1.0 - f.x) * (y == 1 ? f.y : 1.0 - f.y);
+            float weight = bilinear * exp(-guide_distance / (GUIDE_SIGMA * GUIDE_SIGMA));
+
+            color_sum += weight * color;
+            weight_sum += weight;
+
+            if (guide_distance < closest_distance)
+            {
+                closest_distance = guide_distance;
+                closest_color = color;
+            }
+        }
+    }
+
+    out_frag_color = (weight_sum > 1e-4) ? color_sum / weight_sum : closest_color;
+}
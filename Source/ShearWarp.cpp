@@ -0,0 +1,555 @@
+#include "ShearWarp.h"
+#include "CpuRayCaster.h"
+#include "CpuPacketKernels.h"
+#include "Downsample.h"
+#include "RenderConstants.h"
+#include "Core/Win32.h"
+
+#include <algorithm>
+#include <cmath>
+#include <new>
+#include <numeric>
+#include <sstream>
+
+// Note: Opacity at which a pixel of the intermediate image counts as opaque, the same as the ray casters stop at
+#define OPAQUE_ALPHA 0.99f
+
+// Where a slice lands in the intermediate image, voxel (i, j) of it at (i, j) * scale + offset
+struct SliceTransform
+{
+    int slice;
+    float scale;
+    glm::vec2 offset;
+};
+
+// The first pixel from `u` on which isn't opaque yet, opaque pixels link to the one after them. The links are
+// shortened along the way, so runs of opaque pixels are skipped in one step the next time around.
+static int FindOpenPixel(std::vector<int>& next_open, int u)
+{
+    int open = u;
+    while (next_open[open] != open)
+        open = next_open[open];
+
+    while (next_open[u] != open)
+    {
+        const int next = next_open[u];
+        next_open[u] = open;
+        u = next;
+    }
+    return open;
+}
+
+ShearWarpRenderer::ShearWarpRenderer(const glm::ivec3& dimensions, const unsigned char* voxels, VolumeDataType type, const glm::vec2& data_range)
+    : dimensions(dimensions), data_range(data_range)
+{
+    const float extent = data_range.y - data_range.x;
+    const float scale = (extent > 0.f) ? 65535.f / extent : 0.f;
+
+    auto quantized = std::make_shared<std::vector<uint16_t>>((size_t)dimensions.x * dimensions.y * dimensions.z);
+    const unsigned int byte_count = GetDataTypeSize(type);
+    const size_t slice_size = (size_t)dimensions.x * dimensions.y;
+    ThreadPool::Get().ParallelFor(dimensions.z, [&](size_t z)
+    {
+        const unsigned char* src = voxels + z * slice_size * byte_count;
+        uint16_t* dst = quantized->data() + z * slice_size;
+        for (size_t i = 0; i < slice_size; ++i)
+        {
+            // Note: NaNs end up at 0
+            const float value = (GetVoxelValue(src + i * byte_count, type) - data_range.x) * scale;
+            dst[i] = (uint16_t)(std::clamp(value, 0.f, 65535.f) + 0.5f);
+        }
+    });
+    values = std::move(quantized);
+
+    // Note: Nothing shows up until the volume is classified
+    for (int axis = 0; axis < 3; ++axis)
+        slices[axis].resize(dimensions[axis]);
+}
+
+ShearWarpRenderer::ShearWarpRenderer(const glm::ivec3& dimensions, std::shared_ptr<const std::vector<uint16_t>> values, const glm::vec2& data_range)
+    : dimensions(dimensions), values(std::move(values)), data_range(data_range)
+{
+    for (int axis = 0; axis < 3; ++axis)
+        slices[axis].resize(dimensions[axis]);
+}
+
+std::unique_ptr<ShearWarpRenderer> ShearWarpRenderer::ShareVoxels() const
+{
+    return std::unique_ptr<ShearWarpRenderer>(new ShearWarpRenderer(dimensions, values, data_range));
+}
+
+void ShearWarpRenderer::Classify(const std::vector<uint8_t>& colormap, const glm::vec2& value_range)
+{
+    // Note: Linear filtering of the transfer function at the centre of every level, as its texture is sampled
+    const int texel_count = std::max((int)(colormap.size() / 4), 1);
+    level_colors.resize(SHEAR_WARP_LEVELS);
+    for (int level = 0; level < SHEAR_WARP_LEVELS; ++level)
+    {
+        const float position = ((float)level + 0.5f) / SHEAR_WARP_LEVELS * texel_count - 0.5f;
+        const float base = std::floor(position);
+        const float f = position - base;
+        const int i0 = std::clamp((int)base, 0, texel_count - 1);
+        const int i1 = std::clamp((int)base + 1, 0, texel_count - 1);
+
+        glm::vec4 color(0.f);
+        if (colormap.size() >= 4)
+        {
+            for (int channel = 0; channel < 4; ++channel)
+                color[channel] = (colormap[i0 * 4 + channel] + (colormap[i1 * 4 + channel] - colormap[i0 * 4 + channel]) * f) / 255.f;
+        }
+        level_colors[level] = color;
+    }
+
+    // The level of every 16 bit value, mapped over the value range the way the ray casters map it. An empty range (a
+    // constant volume) maps everything to 0 like it does on the GPU.
+    const float value_extent = value_range.y - value_range.x;
+    std::vector<uint16_t> value_levels(65536);
+    for (int value = 0; value < 65536; ++value)
+    {
+        const float data_value = data_range.x + (data_range.y - data_range.x) * (float)value / 65535.f;
+        const float position = (value_extent > 0.f) ? std::clamp((data_value - value_range.x) / value_extent, 0.f, 1.f) : 0.f;
+        value_levels[value] = (uint16_t)std::min((int)(position * SHEAR_WARP_LEVELS), SHEAR_WARP_LEVELS - 1);
+    }
+
+    const glm::ivec3 strides(1, dimensions.x, dimensions.x * dimensions.y);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const int i_axis = (axis + 1) % 3;
+        const int j_axis = (axis + 2) % 3;
+        const int row_length = dimensions[i_axis];
+        const int row_count = dimensions[j_axis];
+
+        ThreadPool::Get().ParallelFor(dimensions[axis], [&](size_t s)
+        {
+            RunLengthSlice& slice = slices[axis][s];
+            slice.row_runs.resize(row_count + 1);
+            slice.row_levels.resize(row_count + 1);
+            slice.runs.clear();
+            slice.levels.clear();
+
+            // Note: Runs longer than a run can hold are split with an empty run of the other kind in between
+            auto push_run = [&slice](int length)
+            {
+                for (; length > 0xFFFF; length -= 0xFFFF)
+                {
+                    slice.runs.push_back(0xFFFF);
+                    slice.runs.push_back(0);
+                }
+                slice.runs.push_back((uint16_t)length);
+            };
+
+            for (int j = 0; j < row_count; ++j)
+            {
+                slice.row_runs[j] = (uint32_t)slice.runs.size();
+                slice.row_levels[j] = (uint32_t)slice.levels.size();
+
+                const uint16_t* row = values->data() + s * strides[axis] + (size_t)j * strides[j_axis];
+                const size_t stride = strides[i_axis];
+                for (int i = 0; i < row_length;)
+                {
+                    int begin = i;
+                    while (i < row_length && level_colors[value_levels[row[i * stride]]].a <= 0.f)
+                        ++i;
+                    push_run(i - begin);
+
+                    begin = i;
+                    for (; i < row_length; ++i)
+                    {
+                        const uint16_t level = value_levels[row[i * stride]];
+                        if (level_colors[level].a <= 0.f)
+                            break;
+                        slice.levels.push_back(level);
+                    }
+                    if (i > begin)
+                        push_run(i - begin);
+                }
+            }
+            slice.row_runs[row_count] = (uint32_t)slice.runs.size();
+            slice.row_levels[row_count] = (uint32_t)slice.levels.size();
+
+            slice.runs.shrink_to_fit();
+            slice.levels.shrink_to_fit();
+        });
+    }
+}
+
+void ShearWarpRenderer::DecodeRow(const RunLengthSlice& slice, int row_count, int j, const std::vector<glm::vec4>& colors_by_level,
+    std::vector<glm::vec4>& colors, std::vector<glm::ivec2>& spans) const
+{
+    spans.clear();
+    if (j < 0 || j >= row_count || slice.row_runs.empty())
+        return;
+
+    const uint16_t* run = slice.runs.data() + slice.row_runs[j];
+    const uint16_t* runs_end = slice.runs.data() + slice.row_runs[j + 1];
+    const uint16_t* level = slice.levels.data() + slice.row_levels[j];
+
+    int i = 0;
+    while (run != runs_end)
+    {
+        // Note: Transparent runs are skipped, their voxels are 0 in `colors` already
+        i += *run++;
+        if (run == runs_end)
+            break;
+
+        const int length = *run++;
+        if (length == 0)
+            continue;
+
+        if (!spans.empty() && spans.back().y == i)
+            spans.back().y += length;
+        else
+            spans.emplace_back(i, i + length);
+
+        for (const int end = i + length; i < end; ++i)
+            colors[i + 1] = colors_by_level[*level++];
+    }
+}
+
+bool ShearWarpRenderer::Render(const glm::mat4& inverse_pvm, int width, int height, std::vector<uint8_t>& pixels, bool bottom_up,
+    ThreadPool& thread_pool) const
+{
+    if (level_colors.empty())
+        return false;
+
+    // From normalized device coordinates to voxel coordinates, with the voxel centres at whole numbers
+    const glm::vec3 volume_dimensions(dimensions);
+    glm::mat4 to_voxels(1.f);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        to_voxels[axis][axis] = volume_dimensions[axis];
+        to_voxels[3][axis] = -0.5f;
+    }
+    const glm::mat4 inverse_voxel_pvm = to_voxels * inverse_pvm;
+
+    // The eye in homogeneous coordinates, a direction (the one the view looks along) for parallel projections
+    const glm::vec4 eye = inverse_voxel_pvm * glm::vec4(0.f, 0.f, 1.f, 0.f);
+    const bool perspective = std::abs(eye.w) > 1e-6f * glm::length(glm::vec3(eye));
+    const glm::vec3 eye_point = perspective ? glm::vec3(eye) / eye.w : glm::vec3(0.f);
+    const glm::vec3 direction = perspective ? (volume_dimensions - 1.f) * 0.5f - eye_point : glm::vec3(eye);
+
+    // The principal axis is the one the central ray runs along the most, among those which have the eye outside the
+    // slab of the volume (every point of the volume then lies on the same side of the eye along it)
+    int axis = -1;
+    for (int a = 0; a < 3; ++a)
+    {
+        const bool outside = !perspective || eye_point[a] < -0.5f || eye_point[a] > volume_dimensions[a] - 0.5f;
+        if (outside && (axis < 0 || std::abs(direction[a]) > std::abs(direction[axis])))
+            axis = a;
+    }
+    if (axis < 0 || direction[axis] == 0.f)
+        return false;
+
+    const int i_axis = (axis + 1) % 3;
+    const int j_axis = (axis + 2) % 3;
+    const int slice_count = dimensions[axis];
+    const glm::ivec2 slice_size(dimensions[i_axis], dimensions[j_axis]);
+    const int front = (direction[axis] > 0.f) ? 0 : slice_count - 1;
+    const int step = (direction[axis] > 0.f) ? 1 : -1;
+
+    // Note: Points project onto the front slice along the line through them and the eye. For a point in slice s that
+    // works out to a scale of a / (a + (s - front) * w) about it, with a = front * w - eye_k, and the shift of
+    // (s - front) * eye_ij / (a + (s - front) * w). The front slice itself lands as it is.
+    const glm::vec2 eye_ij(eye[i_axis], eye[j_axis]);
+    const float a = (float)front * eye.w - eye[axis];
+    std::vector<SliceTransform> transforms(slice_count);
+    glm::vec2 image_min(INFINITY), image_max(-INFINITY);
+    for (int n = 0; n < slice_count; ++n)
+    {
+        const int s = front + n * step;
+        const float d = (float)(s - front);
+        const float denominator = a + d * eye.w;
+        transforms[n] = { s, a / denominator, d * eye_ij / denominator };
+
+        // Note: The classified voxels reach from -1 to the row length, one voxel of padding on either side
+        image_min = glm::min(image_min, transforms[n].offset - transforms[n].scale);
+        image_max = glm::max(image_max, transforms[n].offset + transforms[n].scale * glm::vec2(slice_size));
+    }
+
+    const glm::ivec2 image_origin = glm::ivec2(glm::floor(image_min));
+    const glm::ivec2 composited_size = glm::ivec2(glm::ceil(image_max)) - image_origin + 1;
+    const int max_size = 4 * std::max(std::max(dimensions.x, dimensions.y), dimensions.z);
+    if (composited_size.x > max_size || composited_size.y > max_size)
+        return false;
+
+    // Note: With a border of one pixel on every side, for the warp
+    const glm::ivec2 image_size = composited_size + 2;
+
+    // Note: Slices are sampled once per voxel along the principal axis, the opacity is corrected for the length of
+    // that step along the central ray in texture space (which is what the ray casters measure their steps in)
+    const glm::vec3 slice_step = direction / std::abs(direction[axis]) / volume_dimensions;
+    const float correction = glm::length(slice_step) * REF_SAMPLING_INTERVAL;
+    std::vector<glm::vec4> colors(SHEAR_WARP_LEVELS);
+    for (int level = 0; level < SHEAR_WARP_LEVELS; ++level)
+    {
+        const glm::vec4& color = level_colors[level];
+        const float alpha = 1.f - std::pow(1.f - color.a, correction);
+        colors[level] = glm::vec4(glm::vec3(color) * alpha, alpha);
+    }
+
+    // Compositing, front to back, row by row of the intermediate image
+    std::vector<glm::vec4> intermediate((size_t)image_size.x * image_size.y, glm::vec4(0.f));
+    const std::vector<RunLengthSlice>& copy = slices[axis];
+    thread_pool.ParallelFor(composited_size.y, [&](size_t v)
+    {
+        glm::vec4* row = intermediate.data() + (v + 1) * image_size.x + 1;
+
+        std::vector<int> next_open(composited_size.x + 1);
+        std::iota(next_open.begin(), next_open.end(), 0);
+        int open_count = composited_size.x;
+
+        std::vector<glm::vec4> voxel_rows[2] = { std::vector<glm::vec4>(slice_size.x + 2, glm::vec4(0.f)),
+            std::vector<glm::vec4>(slice_size.x + 2, glm::vec4(0.f)) };
+        std::vector<glm::ivec2> spans[2];
+        std::vector<glm::ivec2> pixel_spans;
+
+        for (const SliceTransform& transform : transforms)
+        {
+            const float j_position = ((float)v + image_origin.y - transform.offset.y) / transform.scale;
+            if (j_position <= -1.f || j_position >= (float)slice_size.y)
+                continue;
+
+            const int j0 = (int)std::floor(j_position);
+            const float fj = j_position - (float)j0;
+            const RunLengthSlice& slice = copy[transform.slice];
+            DecodeRow(slice, slice_size.y, j0, colors, voxel_rows[0], spans[0]);
+            DecodeRow(slice, slice_size.y, j0 + 1, colors, voxel_rows[1], spans[1]);
+
+            // Pixels pull in the voxel to their left as well, so a run [b, e) of either row reaches the pixels from
+            // voxel b - 1 on. The runs of both rows are merged, so no pixel gets composited twice.
+            pixel_spans.clear();
+            size_t next[2] = { 0, 0 };
+            while (next[0] < spans[0].size() || next[1] < spans[1].size())
+            {
+                const int r = (next[1] >= spans[1].size() || (next[0] < spans[0].size() && spans[0][next[0]].x <= spans[1][next[1]].x)) ? 0 : 1;
+                const glm::ivec2 span(spans[r][next[r]].x - 1, spans[r][next[r]].y);
+                ++next[r];
+
+                if (!pixel_spans.empty() && span.x <= pixel_spans.back().y)
+                    pixel_spans.back().y = std::max(pixel_spans.back().y, span.y);
+                else
+                    pixel_spans.push_back(span);
+            }
+
+            const float inverse_scale = 1.f / transform.scale;
+            for (const glm::ivec2& span : pixel_spans)
+            {
+                const float u_offset = transform.offset.x - (float)image_origin.x;
+                const int u_begin = std::max((int)std::ceil((float)span.x * transform.scale + u_offset), 0);
+                const int u_end = std::min((int)std::ceil((float)span.y * transform.scale + u_offset), composited_size.x);
+                if (u_begin >= u_end)
+                    continue;
+
+                for (int u = FindOpenPixel(next_open, u_begin); u < u_end; u = FindOpenPixel(next_open, u + 1))
+                {
+                    const float i_position = ((float)u - u_offset) * inverse_scale;
+                    const int i0 = std::clamp((int)std::floor(i_position), -1, slice_size.x - 1);
+                    const float fi = i_position - (float)i0;
+
+                    const glm::vec4 c0 = glm::mix(voxel_rows[0][i0 + 1], voxel_rows[0][i0 + 2], fi);
+                    const glm::vec4 c1 = glm::mix(voxel_rows[1][i0 + 1], voxel_rows[1][i0 + 2], fi);
+                    const glm::vec4 color = glm::mix(c0, c1, fj);
+                    if (color.a <= 0.f)
+                        continue;
+
+                    glm::vec4& pixel = row[u];
+                    pixel += (1.f - pixel.a) * color;
+                    if (pixel.a >= OPAQUE_ALPHA)
+                    {
+                        next_open[u] = u + 1;
+                        --open_count;
+                    }
+                }
+            }
+
+            // Note: Only the runs which were expanded have to be cleared again
+            for (int r = 0; r < 2; ++r)
+            {
+                for (const glm::ivec2& span : spans[r])
+                    std::fill(voxel_rows[r].begin() + span.x + 1, voxel_rows[r].begin() + span.y + 1, glm::vec4(0.f));
+            }
+
+            if (open_count == 0)
+                break;
+        }
+    });
+
+    // Warp. The front slice projects onto the image through a 2D projective map (the columns of the projection for its
+    // two axes and for its origin, with the rows for x, y and w), its inverse takes every pixel back to where its ray
+    // crosses the front slice. The w that comes out of the inverse has the sign of the clip space w, pixels whose ray
+    // only reaches the slice behind the eye come out negative.
+    const glm::mat4 voxel_pvm = glm::inverse(inverse_voxel_pvm);
+    glm::mat3 slice_to_clip;
+    for (int row = 0; row < 3; ++row)
+    {
+        const int clip_row = (row < 2) ? row : 3;
+        slice_to_clip[0][row] = voxel_pvm[i_axis][clip_row];
+        slice_to_clip[1][row] = voxel_pvm[j_axis][clip_row];
+        slice_to_clip[2][row] = voxel_pvm[axis][clip_row] * (float)front + voxel_pvm[3][clip_row];
+    }
+    const glm::mat3 image_to_slice = glm::inverse(slice_to_clip);
+    const glm::vec3 pixel_step = image_to_slice[0] * (2.f / (float)width);
+
+    // Note: The intermediate image has a border of transparent pixels, positions are clamped into it rather than checked
+    const glm::vec2 max_position = glm::vec2(image_size - 1) - 0.001f;
+    const glm::vec2 origin = glm::vec2(image_origin) - 1.f;
+
+    pixels.resize((size_t)width * height * 4);
+    thread_pool.ParallelFor(height, [&](size_t y)
+    {
+        const float ndc_y = ((float)y + 0.5f) / (float)height * 2.f - 1.f;
+        glm::vec3 position = image_to_slice * glm::vec3(1.f / (float)width - 1.f, ndc_y, 1.f);
+
+        // Note: y runs up from the bottom like gl_FragCoord does
+        uint8_t* pixel_row = pixels.data() + (size_t)(bottom_up ? y : height - 1 - y) * width * 4;
+        for (int x = 0; x < width; ++x, position += pixel_step)
+        {
+            glm::vec4 color(0.f);
+            if (position.z > 0.f)
+            {
+                const glm::vec2 texel_position = glm::clamp(glm::vec2(position) / position.z - origin, glm::vec2(0.f), max_position);
+                const glm::ivec2 base = glm::ivec2(texel_position);
+                const glm::vec2 f = texel_position - glm::vec2(base);
+
+                const glm::vec4* texels = intermediate.data() + (size_t)base.y * image_size.x + base.x;
+                const glm::vec4 c0 = glm::mix(texels[0], texels[1], f.x);
+                const glm::vec4 c1 = glm::mix(texels[image_size.x], texels[image_size.x + 1], f.x);
+                color = glm::mix(c0, c1, f.y);
+            }
+
+            color = glm::clamp(BlendBackground(color), 0.f, 1.f);
+            for (int channel = 0; channel < 4; ++channel)
+                pixel_row[x * 4 + channel] = (uint8_t)(color[channel] * 255.f + 0.5f);
+        }
+    });
+
+    return true;
+}
+
+ShearWarpBuilder::~ShearWarpBuilder()
+{
+    Cancel();
+}
+
+void ShearWarpBuilder::Build(const Volume& volume, const std::vector<uint8_t>& colormap, const glm::vec2& value_range)
+{
+    Cancel();
+
+    failed = false;
+    done = false;
+    cancel_requested = false;
+    worker = std::thread(&ShearWarpBuilder::Run, this, &volume, colormap, value_range);
+}
+
+void ShearWarpBuilder::Reclassify(const ShearWarpRenderer& renderer, const std::vector<uint8_t>& colormap, const glm::vec2& value_range)
+{
+    Cancel();
+
+    failed = false;
+    done = false;
+    cancel_requested = false;
+    worker = std::thread(&ShearWarpBuilder::RunReclassify, this, &renderer, colormap, value_range);
+}
+
+void ShearWarpBuilder::Cancel()
+{
+    cancel_requested = true;
+    if (worker.joinable())
+        worker.join();
+    built = nullptr;
+}
+
+std::unique_ptr<ShearWarpRenderer> ShearWarpBuilder::TakeBuilt()
+{
+    if (!done || !worker.joinable())
+        return nullptr;
+
+    worker.join();
+    failed = !built;
+    return std::move(built);
+}
+
+void ShearWarpBuilder::Run(const Volume* volume, std::vector<uint8_t> colormap, glm::vec2 value_range)
+{
+    const VolumeDesc& desc = volume->desc;
+    const unsigned int byte_count = desc.GetByteCount();
+    const glm::ivec3 extent = volume->GetRegionExtent();
+    const int factor = volume->downsample_factor;
+    const glm::ivec3 dimensions = GetDownsampledDimensions(extent, factor);
+    const size_t src_slice_size = (size_t)extent.x * extent.y * byte_count;
+    const size_t dst_slice_size = (size_t)dimensions.x * dimensions.y * byte_count;
+    const int chunk_depth = (int)std::max<size_t>(1, 64 * 1024 * 1024 / (src_slice_size * factor));
+
+    // Note: std::bad_alloc is the only way to find out that a volume is too large for what is left of the memory
+    bool success = true;
+    try
+    {
+        // Read a few slices of the texture at a time, the way the loader does
+        std::vector<unsigned char> voxels(dimensions.z * dst_slice_size);
+        std::vector<unsigned char> scratch;
+        for (int z = 0; z < dimensions.z && success && !cancel_requested; z += chunk_depth)
+        {
+            // Note: The last slice also takes in the slices left over by the division
+            const int chunk_end = std::min(z + chunk_depth, dimensions.z);
+            const glm::ivec3 begin(volume->region_begin.x, volume->region_begin.y, volume->region_begin.z + z * factor);
+            const glm::ivec3 end(volume->region_end.x, volume->region_end.y,
+                (chunk_end == dimensions.z) ? volume->region_end.z : volume->region_begin.z + chunk_end * factor);
+
+            // Note: Without downsampling the slices go straight where they belong
+            unsigned char* dst = voxels.data() + z * dst_slice_size;
+            if (factor == 1)
+            {
+                success = volume->ReadRegion(begin, end, dst);
+                continue;
+            }
+
+            scratch.resize((size_t)(end.z - begin.z) * src_slice_size);
+            success = volume->ReadRegion(begin, end, scratch.data());
+            DownsampleVolume(scratch.data(), glm::ivec3(extent.x, extent.y, end.z - begin.z), desc.data_type, factor, dst);
+        }
+
+        if (success && !cancel_requested)
+        {
+            scratch = std::vector<unsigned char>();
+            built = std::make_unique<ShearWarpRenderer>(dimensions, voxels.data(), desc.data_type, volume->data_range);
+
+            voxels = std::vector<unsigned char>();
+            built->Classify(colormap, value_range);
+        }
+    }
+    catch (const std::bad_alloc&)
+    {
+        success = false;
+    }
+
+    if (!success)
+    {
+        built = nullptr;
+
+        std::ostringstream oss;
+        oss << "Unable to read the voxels of " << desc.path << " for shear-warp" << std::endl;
+        OutputDebugStringA(oss.str().c_str());
+    }
+
+    done = true;
+}
+
+void ShearWarpBuilder::RunReclassify(const ShearWarpRenderer* renderer, std::vector<uint8_t> colormap, glm::vec2 value_range)
+{
+    // Note: Classification can't be interrupted, a cancelled one just isn't handed out
+    try
+    {
+        built = renderer->ShareVoxels();
+        built->Classify(colormap, value_range);
+    }
+    catch (const std::bad_alloc&)
+    {
+        built = nullptr;
+        OutputDebugStringA("Unable to allocate the classified volume for shear-warp\n");
+    }
+
+    if (cancel_requested)
+        built = nullptr;
+
+    done = true;
+}
@@ -0,0 +1,135 @@
+#ifndef SHEAR_WARP_H
+
+#include "ThreadPool.h"
+#include "Volume.h"
+
+#include <glm/glm.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Transfer function positions are quantized to this many levels in the classified volumes
+#define SHEAR_WARP_LEVELS 4096
+
+// Shear-warp renderer (Lacroute and Levoy), far cheaper on the CPU than ray casting. The volume is classified once per
+// transfer function into three copies, sliced along X, Y and Z, whose rows are run-length encoded into runs of
+// transparent voxels (of which nothing is stored) and runs of classified ones. A frame picks the copy whose slices face
+// the viewer the most, composites its slices front to back into an intermediate image lying in the front slice, each
+// one scaled and shifted to where it projects (a shear for parallel projections), and warps that to the image.
+// Compositing skips transparent runs without looking at their voxels, and pixels which are already opaque through
+// links to the next pixel which isn't.
+//
+// Note: Slices are resampled with bilinear filtering of the classified (premultiplied) colours, with one sample per
+// slice and the opacity corrected for the spacing of the slices along the central ray. The image differs from the ray
+// casters' in the filtering and at the edges of the volume (there are no samples between the outermost voxel centres
+// and the faces), not in what it shows. Rows of the intermediate image are spread over the thread pool.
+struct ShearWarpRenderer
+{
+    // Takes a copy of the voxels (`dimensions`, X-major, little endian), quantized to 16 bits over `data_range`
+    ShearWarpRenderer(const glm::ivec3& dimensions, const unsigned char* voxels, VolumeDataType type, const glm::vec2& data_range);
+
+    // Classifies the volume with `colormap` (RGBA8 texels spanning [0, 1], as TransferFunctionWidget hands them out)
+    // mapped over `value_range`, and rebuilds the run-length encoded copies in parallel. Nothing shows up before it has
+    // been called, it has to be called again whenever either of them changes.
+    void Classify(const std::vector<uint8_t>& colormap, const glm::vec2& value_range);
+
+    // Renders a `width` x `height` image into `pixels`, the same way CpuRayCaster::Render does, with the rows top first
+    // or, with `bottom_up`, bottom first the way glTexImage2D takes them. Returns false, leaving `pixels` alone, for
+    // views which can't be factored into a shear and a warp: perspective views from within the volume (or close
+    // enough to one of its faces that the intermediate image would blow up).
+    bool Render(const glm::mat4& inverse_pvm, int width, int height, std::vector<uint8_t>& pixels, bool bottom_up = false,
+        ThreadPool& thread_pool = ThreadPool::Get()) const;
+
+    // A renderer which shares the voxels of this one but not its classification, for classifying them anew while this
+    // one keeps rendering
+    std::unique_ptr<ShearWarpRenderer> ShareVoxels() const;
+
+    const glm::ivec3 dimensions;
+
+private:
+    ShearWarpRenderer(const glm::ivec3& dimensions, std::shared_ptr<const std::vector<uint16_t>> values, const glm::vec2& data_range);
+
+    // A slice of a classified copy. Every row is a sequence of runs, alternating between transparent and classified
+    // voxels and starting with a transparent one (which may be empty). Only the levels of the classified voxels are
+    // stored.
+    struct RunLengthSlice
+    {
+        // Index of the first run and of the first level of every row, with one more at the end
+        std::vector<uint32_t> row_runs;
+        std::vector<uint32_t> row_levels;
+
+        std::vector<uint16_t> runs;
+        std::vector<uint16_t> levels;
+    };
+
+    // Expands row `j` of `slice` into `colors` (from index 1 on, with one voxel of padding on either side) as looked
+    // up in `colors_by_level`, and lists its runs of classified voxels in `spans`. Rows outside of the slice are empty.
+    void DecodeRow(const RunLengthSlice& slice, int row_count, int j, const std::vector<glm::vec4>& colors_by_level,
+        std::vector<glm::vec4>& colors, std::vector<glm::ivec2>& spans) const;
+
+    // The voxels, quantized to 16 bits over `data_range`. They never change once quantized, so renderers classifying
+    // them differently share them.
+    std::shared_ptr<const std::vector<uint16_t>> values;
+    glm::vec2 data_range;
+
+    // Colour (not premultiplied) and opacity of every level, before the opacity correction
+    std::vector<glm::vec4> level_colors;
+
+    // The classified volume three times over, sliced along X, Y and Z. The rows of the slices along axis k run along
+    // axis (k + 1) % 3, one after the other along axis (k + 2) % 3.
+    std::vector<RunLengthSlice> slices[3];
+};
+
+// Builds a ShearWarpRenderer for a Volume on a worker thread of its own, so the render thread never waits on the disk.
+// The renderer gets the voxels the texture of the volume was made from, the region of interest downsampled by the
+// volume's `downsample_factor`, which keeps it within the texture budget. The region is read a few slices at a time.
+//
+// It also classifies the voxels of a renderer anew in the background (see Reclassify), which keeps the render thread
+// going while the transfer function is edited.
+//
+// Note: Builds which can't read the voxels or allocate the renderer fail (and log why) instead of taking the app down
+struct ShearWarpBuilder
+{
+    ShearWarpBuilder() = default;
+    ~ShearWarpBuilder();
+
+    ShearWarpBuilder(const ShearWarpBuilder&) = delete;
+    ShearWarpBuilder& operator=(const ShearWarpBuilder&) = delete;
+
+    // Starts building a renderer for `volume`, classified with `colormap` over `value_range`, cancelling the build in
+    // flight (if any). `volume` has to stay alive until the build is done or has been cancelled.
+    void Build(const Volume& volume, const std::vector<uint8_t>& colormap, const glm::vec2& value_range);
+
+    // Starts classifying the voxels of `renderer` with `colormap` over `value_range`, into a renderer of its own which
+    // shares them, so `renderer` can keep rendering until TakeBuilt hands out the new one. Cancels the build in flight
+    // (if any). `renderer` has to stay alive until the build is done or has been cancelled.
+    void Reclassify(const ShearWarpRenderer& renderer, const std::vector<uint8_t>& colormap, const glm::vec2& value_range);
+
+    // Stops the build in flight (if any) and waits for the worker to finish, after which the volume may go away
+    void Cancel();
+
+    // Hands out the renderer once the build is done, nullptr before that and if it failed. Call once per frame.
+    std::unique_ptr<ShearWarpRenderer> TakeBuilt();
+
+    // True while a build is running or waiting to be taken
+    inline bool IsBuilding() const { return worker.joinable(); }
+
+    // True if the last build failed, until the next one is started
+    bool failed = false;
+
+private:
+    void Run(const Volume* volume, std::vector<uint8_t> colormap, glm::vec2 value_range);
+    void RunReclassify(const ShearWarpRenderer* renderer, std::vector<uint8_t> colormap, glm::vec2 value_range);
+
+    std::thread worker;
+    std::atomic<bool> done = false;
+    std::atomic<bool> cancel_requested = false;
+
+    // Note: Only touched by the worker until `done` is set
+    std::unique_ptr<ShearWarpRenderer> built;
+};
+
+#define SHEAR_WARP_H
+#endif
@@ -0,0 +1,174 @@
+#include "SlabUploader.h"
+#include "Core/Win32.h"
+
+#include <algorithm>
+#include <sstream>
+
+SlabUploader::SlabUploader(Texture3D& texture, GLenum format, GLenum type, size_t bytes_per_voxel, int depth_alignment, size_t slab_size,
+    unsigned int ring_size, bool readable)
+    : texture(&texture), format(format), type(type), slice_size((size_t)texture.width * texture.height * bytes_per_voxel), readable(readable)
+{
+    // Note: A single slice might be larger than the requested slab size, in that case every slab is just one slice
+    slab_depth = (int)std::max<size_t>(1, slab_size / slice_size);
+    slab_depth = std::max(depth_alignment, slab_depth - slab_depth % depth_alignment);
+    slab_depth = std::min(slab_depth, texture.depth);
+    const GLsizeiptr buffer_size = (GLsizeiptr)(slab_depth * slice_size);
+
+    // Note: GL_CLIENT_STORAGE_BIT is only a hint, but together with GL_MAP_READ_BIT it gets drivers to keep the buffer
+    // in cached system memory, which the upload is DMAed from either way
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    if (readable)
+        flags |= GL_MAP_READ_BIT;
+
+    slots.resize(ring_size);
+    for (Slot& slot : slots)
+    {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, buffer_size, nullptr, readable ? (flags | GL_CLIENT_STORAGE_BIT) : flags);
+        slot.data = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, buffer_size, flags);
+
+        // Note: Mapping fails when the driver runs out of (mappable) memory, the slot uploads from client memory instead
+        if (!slot.data)
+        {
+            std::ostringstream oss;
+            oss << "Unable to map a pixel buffer of " << buffer_size << " bytes, uploading from client memory instead" << std::endl;
+            OutputDebugStringA(oss.str().c_str());
+
+            glDeleteBuffers(1, &slot.pbo);
+            slot.pbo = 0;
+            slot.client_memory.resize((size_t)buffer_size);
+            slot.data = slot.client_memory.data();
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+SlabUploader::~SlabUploader()
+{
+    Abort();
+
+    for (Slot& slot : slots)
+    {
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+
+        // Note: Deleting a buffer also unmaps it, and the GL keeps it alive until the pending upload from it is done
+        if (slot.pbo)
+            glDeleteBuffers(1, &slot.pbo);
+    }
+}
+
+bool SlabUploader::AcquireSlab(Slab& slab)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    std::vector<Slot>::iterator free_slot;
+    slot_freed.wait(lock, [&]
+    {
+        free_slot = std::find_if(slots.begin(), slots.end(), [](const Slot& s) { return s.state == SlotState::FREE; });
+        return aborted || next_z >= texture->depth || free_slot != slots.end();
+    });
+
+    if (aborted || next_z >= texture->depth)
+        return false;
+
+    free_slot->slab = { free_slot->data, next_z, std::min(slab_depth, texture->depth - next_z), readable || !free_slot->pbo };
+    free_slot->state = SlotState::FILLING;
+    next_z += free_slot->slab.depth;
+
+    slab = free_slot->slab;
+    return true;
+}
+
+void SlabUploader::SubmitSlab(const Slab& slab)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Slot& slot : slots)
+    {
+        if (slot.data == slab.data)
+            slot.state = SlotState::FILLED;
+    }
+}
+
+void SlabUploader::Update(size_t byte_budget)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    bool any_freed = false;
+    for (Slot& slot : slots)
+    {
+        if (slot.state == SlotState::IN_FLIGHT)
+        {
+            GLenum status = glClientWaitSync(slot.fence, 0, 0);
+            if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+            {
+                glDeleteSync(slot.fence);
+                slot.fence = nullptr;
+                slot.state = SlotState::FREE;
+                any_freed = true;
+            }
+        }
+    }
+
+    texture->Bind();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    size_t uploaded_bytes = 0;
+    for (Slot& slot : slots)
+    {
+        if (slot.state != SlotState::FILLED || (uploaded_bytes != 0 && uploaded_bytes >= byte_budget))
+            continue;
+
+        if (slot.pbo)
+        {
+            // Source of the upload is the PBO, so the "pointer" is an offset into it
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+            glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, slot.slab.z_begin, texture->width, texture->height, slot.slab.depth, format, type, (const void*)0);
+
+            slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            slot.state = SlotState::IN_FLIGHT;
+        }
+        else
+        {
+            // Note: The driver is done with client memory once the call returns, the slot is free again right away
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, slot.slab.z_begin, texture->width, texture->height, slot.slab.depth, format, type, slot.data);
+
+            slot.state = SlotState::FREE;
+            any_freed = true;
+        }
+
+        uploaded_bytes += slot.slab.depth * slice_size;
+        uploaded_depth += slot.slab.depth;
+    }
+
+    // Note: Leaving a PBO bound would turn the data pointer of every other client memory upload into an offset
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    texture->Unbind();
+
+    if (any_freed)
+        slot_freed.notify_all();
+
+    // Make sure the fences actually get to the GPU, otherwise we could wait on them forever
+    glFlush();
+}
+
+void SlabUploader::Restart(Texture3D& next_texture)
+{
+    // Note: Slabs still in flight belong to the previous texture, they are recycled by Update() as usual
+    std::lock_guard<std::mutex> lock(mutex);
+    texture = &next_texture;
+    next_z = 0;
+    uploaded_depth = 0;
+    aborted = false;
+}
+
+void SlabUploader::Abort()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        aborted = true;
+    }
+    slot_freed.notify_all();
+}
@@ -0,0 +1,98 @@
+#ifndef SLAB_UPLOADER_H
+
+#include "Texture3D.h"
+
+#include <glad/glad.h>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+// A range of Z slices of the texture, `data` points into a persistently mapped pixel buffer object (or client memory,
+// where the PBO couldn't be mapped) which the producer has to fill with `depth` tightly packed slices
+struct Slab
+{
+    unsigned char* data;
+    int z_begin;
+    int depth;
+
+    // Whether `data` can be read back at the speed of ordinary memory, otherwise it is only fit for writing once
+    bool readable;
+};
+
+// Streams the contents of a Texture3D one Z-slab at a time through a ring of persistently mapped PBOs.
+//
+// A producer thread acquires free slabs and fills them (this is where the disk reads happen), while the render thread
+// calls Update() once per frame to issue glTexSubImage3D for the filled ones. So reading of slab N+1 overlaps the
+// upload of slab N, and the amount of data handed to the driver per frame is bounded by a budget.
+//
+// Note: The constructor, destructor and Update() must be called on the thread which owns the OpenGL context,
+// AcquireSlab() and SubmitSlab() can be called from any thread. Slots whose PBO can't be mapped fall back to uploads
+// from client memory, which are slower (the driver copies them before glTexSubImage3D returns) but still stream.
+struct SlabUploader
+{
+    // Note: Slabs are `depth_alignment` slices deep (or a multiple of it), except for the last one. With `readable` the
+    // PBOs are asked to live in cached client memory rather than write combined memory, for producers which look at
+    // the voxels again after writing them.
+    SlabUploader(Texture3D& texture, GLenum format, GLenum type, size_t bytes_per_voxel, int depth_alignment = 1, size_t slab_size = 16 * 1024 * 1024,
+        unsigned int ring_size = 3, bool readable = false);
+    ~SlabUploader();
+
+    SlabUploader(const SlabUploader&) = delete;
+    SlabUploader& operator=(const SlabUploader&) = delete;
+
+    // Blocks until a slot in the ring is free, returns false once every slab has been handed out or on Abort()
+    bool AcquireSlab(Slab& slab);
+    void SubmitSlab(const Slab& slab);
+
+    // Recycles the slots the GPU is done with and uploads filled slabs until `byte_budget` is used up, at least one
+    // slab gets uploaded every call so that progress is guaranteed
+    void Update(size_t byte_budget);
+
+    // Wakes up the producer, no further slabs will be handed out
+    void Abort();
+
+    // Starts streaming into another texture with the same dimensions and format, reusing the PBOs. Only valid once
+    // the previous texture is done.
+    void Restart(Texture3D& next_texture);
+
+    inline bool IsDone() const { return uploaded_depth == texture->depth; }
+    inline float GetProgress() const { return (float)uploaded_depth / (float)texture->depth; }
+
+private:
+    enum class SlotState
+    {
+        FREE,
+        FILLING,
+        FILLED,
+        IN_FLIGHT
+    };
+
+    struct Slot
+    {
+        // Note: 0 for slots which upload from `client_memory` instead
+        GLuint pbo;
+        unsigned char* data;
+        std::vector<unsigned char> client_memory;
+        Slab slab;
+        SlotState state = SlotState::FREE;
+        GLsync fence = nullptr;
+    };
+
+    Texture3D* texture;
+    const GLenum format;
+    const GLenum type;
+    const size_t slice_size;
+    const bool readable;
+    int slab_depth;
+
+    std::vector<Slot> slots;
+    int next_z = 0;
+    int uploaded_depth = 0;
+    bool aborted = false;
+
+    std::mutex mutex;
+    std::condition_variable slot_freed;
+};
+
+#define SLAB_UPLOADER_H
+#endif
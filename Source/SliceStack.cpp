@@ -0,0 +1,253 @@
+#include "SliceStack.h"
+#include "ThreadPool.h"
+#include "Core/Win32.h"
+
+#include <stb_image/stb_image.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+// The extension of `path` in lower case, with the dot
+static std::string GetLowerCaseExtension(const std::string& path)
+{
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return extension;
+}
+
+bool IsSliceImageFile(const std::string& path)
+{
+    const std::string extension = GetLowerCaseExtension(path);
+    return extension == ".png" || extension == ".pgm" || extension == ".bmp" || extension == ".tga" || extension == ".jpg" || extension == ".jpeg";
+}
+
+bool IsSliceStackDirectory(const std::string& path)
+{
+    std::error_code error;
+    if (!std::filesystem::is_directory(path, error))
+        return false;
+
+    for (const auto& entry : std::filesystem::directory_iterator(path, error))
+    {
+        if (entry.is_regular_file() && IsSliceImageFile(entry.path().string()))
+            return true;
+    }
+
+    return false;
+}
+
+// The last run of digits in the file name, -1 if there is none
+static long long GetSliceNumber(const std::string& file_name)
+{
+    const size_t digits_end = file_name.find_last_of("0123456789");
+    if (digits_end == std::string::npos)
+        return -1;
+
+    size_t digits_begin = digits_end;
+    while (digits_begin > 0 && std::isdigit((unsigned char)file_name[digits_begin - 1]))
+        --digits_begin;
+
+    const std::string number = file_name.substr(digits_begin, std::min<size_t>(digits_end + 1 - digits_begin, 18));
+    return std::stoll(number);
+}
+
+// Reads the header of a binary PGM ("P5", whitespace and comments between the fields), `data_offset` gets where the
+// samples start. False if it isn't one.
+static bool ReadPgmHeader(std::istream& stream, int& width, int& height, int& max_value, std::streamoff& data_offset)
+{
+    char magic[2] = {};
+    if (!stream.read(magic, 2) || magic[0] != 'P' || magic[1] != '5')
+        return false;
+
+    int fields[3];
+    for (int& field : fields)
+    {
+        // Note: Comments run from a '#' to the end of the line
+        int c = stream.get();
+        while (c == '#' || std::isspace(c))
+        {
+            if (c == '#')
+            {
+                while (c != '\n' && c != EOF)
+                    c = stream.get();
+            }
+            c = stream.get();
+        }
+        stream.unget();
+
+        if (!(stream >> field) || field <= 0)
+            return false;
+    }
+
+    // Note: A single whitespace character separates the maximum value from the samples
+    if (!std::isspace(stream.get()))
+        return false;
+
+    width = fields[0];
+    height = fields[1];
+    max_value = fields[2];
+    data_offset = stream.tellg();
+    return max_value <= 65535;
+}
+
+// Decodes a binary PGM with a maximum value above 255 into 16 bit samples, which are stored big endian. Returns false if
+// it isn't one. Otherwise `samples` is nullptr if it is truncated, or else freed with stbi_image_free like the images
+// stb_image decodes.
+// Note: The samples are read from the same handle right after the header, every slice is opened and parsed just once
+static bool LoadPgm16(const std::string& path, int& width, int& height, uint16_t*& samples)
+{
+    samples = nullptr;
+    if (GetLowerCaseExtension(path) != ".pgm")
+        return false;
+
+    std::ifstream file(path, std::ios::binary);
+    int max_value;
+    std::streamoff data_offset;
+    if (!file || !ReadPgmHeader(file, width, height, max_value, data_offset) || max_value <= 255)
+        return false;
+
+    const size_t sample_count = (size_t)width * height;
+    samples = (uint16_t*)malloc(sample_count * sizeof(uint16_t));
+    if (!samples)
+        return true;
+
+    if (!file.read((char*)samples, sample_count * sizeof(uint16_t)))
+    {
+        free(samples);
+        samples = nullptr;
+        return true;
+    }
+
+    for (size_t i = 0; i < sample_count; ++i)
+    {
+        const unsigned char* bytes = (const unsigned char*)(samples + i);
+        samples[i] = (uint16_t)((bytes[0] << 8) | bytes[1]);
+    }
+    return true;
+}
+
+// True for binary PGMs with a maximum value above 255, which stb_image refuses to decode, along with their dimensions
+static bool GetPgm16Info(const std::string& path, int& width, int& height)
+{
+    if (GetLowerCaseExtension(path) != ".pgm")
+        return false;
+
+    std::ifstream file(path, std::ios::binary);
+    int max_value;
+    std::streamoff data_offset;
+    return file && ReadPgmHeader(file, width, height, max_value, data_offset) && max_value > 255;
+}
+
+bool SliceStack::Open(const std::string& directory, VolumeDesc& result)
+{
+    std::vector<std::pair<long long, std::string>> slices;
+    bool found_tiff = false;
+
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+    {
+        if (!entry.is_regular_file())
+            continue;
+
+        const std::string name = entry.path().filename().string();
+        if (IsSliceImageFile(name))
+            slices.emplace_back(GetSliceNumber(name), entry.path().string());
+        else
+            found_tiff |= GetLowerCaseExtension(name) == ".tif" || GetLowerCaseExtension(name) == ".tiff";
+    }
+
+    if (slices.empty())
+    {
+        std::ostringstream oss;
+        oss << "No slice images in directory: " << directory;
+        if (found_tiff)
+            oss << ", TIFF isn't supported, convert the slices to PNG";
+        oss << std::endl;
+        OutputDebugStringA(oss.str().c_str());
+        return false;
+    }
+
+    // Note: Sorted by number first, "slice_10.png" comes after "slice_9.png"
+    std::sort(slices.begin(), slices.end());
+    paths.clear();
+    for (const auto& slice : slices)
+        paths.push_back(slice.second);
+
+    int width, height, channels;
+    const bool is_pgm_16 = GetPgm16Info(paths[0], width, height);
+    if (!is_pgm_16 && !stbi_info(paths[0].c_str(), &width, &height, &channels))
+    {
+        std::ostringstream oss;
+        oss << "Unable to read slice image at path: " << paths[0] << " (" << stbi_failure_reason() << ")" << std::endl;
+        OutputDebugStringA(oss.str().c_str());
+        return false;
+    }
+
+    desc = result;
+    desc.dimensions = glm::ivec3(width, height, (int)paths.size());
+    desc.data_type = (is_pgm_16 || stbi_is_16_bit(paths[0].c_str())) ? VolumeDataType::UINT16 : VolumeDataType::UINT8;
+    desc.data_offset = 0;
+    desc.big_endian = false;
+    desc.encoding = VolumeEncoding::RAW;
+    result = desc;
+
+    return true;
+}
+
+bool SliceStack::ReadRegion(const glm::ivec3& begin, const glm::ivec3& end, unsigned char* dst) const
+{
+    const glm::ivec3 extent = end - begin;
+    const unsigned int byte_count = desc.GetByteCount();
+    const size_t row_size = (size_t)extent.x * byte_count;
+    const size_t slice_size = row_size * extent.y;
+    const size_t image_row_size = (size_t)desc.dimensions.x * byte_count;
+
+    // Note: Every slice is a task of its own, decoding is what takes the time and it is all independent. Once a slice
+    // has failed the region is lost anyway, so the slices which haven't started yet are skipped.
+    std::atomic<bool> success = true;
+    ThreadPool::Get().ParallelFor(extent.z, [&](size_t z)
+    {
+        if (!success)
+            return;
+
+        const std::string& path = paths[begin.z + z];
+
+        int width, height, channels;
+        void* pixels = nullptr;
+        uint16_t* samples = nullptr;
+        const bool is_pgm_16 = desc.data_type == VolumeDataType::UINT16 && LoadPgm16(path, width, height, samples);
+        if (is_pgm_16)
+            pixels = samples;
+        else if (desc.data_type == VolumeDataType::UINT16)
+            pixels = stbi_load_16(path.c_str(), &width, &height, &channels, 1);
+        else
+            pixels = stbi_load(path.c_str(), &width, &height, &channels, 1);
+
+        if (!pixels || width != desc.dimensions.x || height != desc.dimensions.y)
+        {
+            std::ostringstream oss;
+            oss << "Unable to decode slice " << begin.z + z << " at path: " << path << " ("
+                << (pixels ? "its dimensions don't match the first slice" : is_pgm_16 ? "truncated 16 bit PGM" : stbi_failure_reason())
+                << ")" << std::endl;
+            OutputDebugStringA(oss.str().c_str());
+
+            stbi_image_free(pixels);
+            success = false;
+            return;
+        }
+
+        // Copy the rows within the region over to the Z offset of the slice
+        const unsigned char* image = (const unsigned char*)pixels;
+        for (int y = 0; y < extent.y; ++y)
+            memcpy(dst + z * slice_size + y * row_size, image + (begin.y + y) * image_row_size + begin.x * byte_count, row_size);
+
+        stbi_image_free(pixels);
+    });
+
+    return success;
+}
@@ -0,0 +1,37 @@
+#ifndef SLICE_STACK_H
+
+#include "Volume.h"
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// True for the image formats slices can be stored in, which are the ones stb_image decodes (PNG, PGM, BMP, TGA, JPEG)
+// Note: stb_image can't decode TIFF, stacks of .tif slices have to be converted to PNG first
+bool IsSliceImageFile(const std::string& path);
+
+// True if `path` is a directory with slice images in it
+bool IsSliceStackDirectory(const std::string& path);
+
+// A volume stored as a directory of 2D images, one per Z slice, ordered by the last number in their file names
+// ("slice_0001.png", "slice_0002.png", ..). Colour images are converted to grey, 16 bit PNGs and binary PGMs with a
+// maximum value above 255 make 16 bit volumes, everything else 8 bit ones.
+//
+// Note: stb_image only decodes 8 bit PGMs, the 16 bit ones are read here
+struct SliceStack
+{
+    // Lists the slices and reads the header of the first one, `desc` gets the dimensions and data type of the stack
+    // (the spacing isn't stored in the images, that one is kept as is). Returns false if there are no slices.
+    bool Open(const std::string& directory, VolumeDesc& desc);
+
+    // Decodes the slices overlapping the region [begin, end) in parallel and copies the part of them within the
+    // region into `dst`, tightly packed in X-major order. Fails if any of them can't be decoded or doesn't match the
+    // first slice, `dst` is incomplete then.
+    bool ReadRegion(const glm::ivec3& begin, const glm::ivec3& end, unsigned char* dst) const;
+
+    std::vector<std::string> paths;
+    VolumeDesc desc;
+};
+
+#define SLICE_STACK_H
+#endif
@@ -1,6 +1,7 @@
 #include "Texture2D.h"
 
 Texture2D::Texture2D(GLsizei width, GLsizei height, GLint internal_format, GLenum format, GLenum type)
+    : width(width), height(height)
 {
     glGenTextures(1, &id);
     Bind();
@@ -14,4 +15,9 @@ Texture2D::Texture2D(GLsizei width, GLsizei height, GLint internal_format, GLenu
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
     glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, type, nullptr);
+}
+
+Texture2D::~Texture2D()
+{
+    glDeleteTextures(1, &id);
 }
\ No newline at end of file
@@ -2,15 +2,19 @@
 
 #include <glad/glad.h>
 
-// TODO: Is is required to free up resources in the destructor?
 struct Texture2D
 {
     Texture2D(GLsizei width, GLsizei height, GLint internal_format, GLenum format, GLenum type);
+    ~Texture2D();
+
+    Texture2D(const Texture2D&) = delete;
+    Texture2D& operator=(const Texture2D&) = delete;
 
     void inline Bind() const { glBindTexture(GL_TEXTURE_2D, id); }
     void inline Unbind() const { glBindTexture(GL_TEXTURE_2D, 0); }
 
     GLuint id;
+    GLsizei width, height;
 };
 
 #define TEXTURE_2D_H
@@ -1,6 +1,7 @@
 #include "Texture3D.h"
 
-Texture3D::Texture3D(GLsizei width, GLsizei height, GLsizei depth, GLint internal_format, GLenum format, GLenum type, void* data)
+Texture3D::Texture3D(GLsizei width, GLsizei height, GLsizei depth, GLenum internal_format, GLsizei level_count)
+    : width(width), height(height), depth(depth), level_count(level_count)
 {
     glGenTextures(1, &id);
     Bind();
@@ -8,13 +9,31 @@ Texture3D::Texture3D(GLsizei width, GLsizei height, GLsizei depth, GLint interna
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, (level_count > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    // Upload it to the GPU, assuming that input volume data inherently doesn't have any row alignment
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-    glTexImage3D(GL_TEXTURE_3D, 0, internal_format, width, height, depth, 0, format, type, data);
+    glTexStorage3D(GL_TEXTURE_3D, level_count, internal_format, width, height, depth);
 
     glBindTexture(GL_TEXTURE_3D, 0);
 }
+
+Texture3D::Texture3D(GLsizei width, GLsizei height, GLsizei depth, GLenum internal_format, GLenum format, GLenum type, const void* data)
+    : Texture3D(width, height, depth, internal_format)
+{
+    if (data)
+    {
+        Bind();
+
+        // Upload it to the GPU, assuming that input volume data inherently doesn't have any row alignment
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, width, height, depth, format, type, data);
+
+        glBindTexture(GL_TEXTURE_3D, 0);
+    }
+}
+
+Texture3D::~Texture3D()
+{
+    glDeleteTextures(1, &id);
+}
@@ -2,14 +2,24 @@
 
 #include <glad/glad.h>
 
+// Note: Storage is immutable (glTexStorage3D), the contents can only be changed with glTexSubImage3D
 struct Texture3D
 {
-    Texture3D(GLsizei width, GLsizei height, GLsizei depth, GLint internal_format, GLenum format, GLenum type, void* data);
+    // Note: With more than one level the texture is filtered trilinearly between them, the shaders pick the level with
+    // textureLod()
+    Texture3D(GLsizei width, GLsizei height, GLsizei depth, GLenum internal_format, GLsizei level_count = 1);
+    Texture3D(GLsizei width, GLsizei height, GLsizei depth, GLenum internal_format, GLenum format, GLenum type, const void* data);
+    ~Texture3D();
+
+    Texture3D(const Texture3D&) = delete;
+    Texture3D& operator=(const Texture3D&) = delete;
 
     void inline Bind() const { glBindTexture(GL_TEXTURE_3D, id); }
     void inline Unbind() const { glBindTexture(GL_TEXTURE_3D, 0); }
 
     GLuint id;
+    GLsizei width, height, depth;
+    GLsizei level_count;
 };
 
 #define TEXTURE_3D_H
@@ -0,0 +1,186 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <random>
+
+// The pool (if any) the calling thread is a worker of and the index of its deque
+static thread_local ThreadPool* local_pool = nullptr;
+static thread_local unsigned int local_index = 0;
+
+ThreadPool::ThreadPool(unsigned int thread_count)
+{
+    // Note: The thread calling ParallelFor works too, so one less worker than requested
+    const unsigned int worker_count = std::max(thread_count, 1u) - 1;
+    for (unsigned int i = 0; i <= worker_count; ++i)
+        queues.push_back(std::make_unique<TaskQueue>());
+
+    for (unsigned int i = 0; i < worker_count; ++i)
+        workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wake_up.notify_all();
+
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+ThreadPool& ThreadPool::Get()
+{
+    static ThreadPool pool(std::thread::hardware_concurrency());
+    return pool;
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& fn, size_t grain_size)
+{
+    if (count == 0)
+        return;
+
+    if (grain_size == 0)
+        grain_size = std::max<size_t>(count / ((size_t)GetThreadCount() * 16), 1);
+
+    if (workers.empty() || count <= grain_size)
+    {
+        for (size_t i = 0; i < count; ++i)
+            fn(i);
+        return;
+    }
+
+    TaskGroup group;
+    RunRange(group, 0, count, grain_size, fn);
+    Wait(group);
+}
+
+void ThreadPool::RunRange(TaskGroup& group, size_t first, size_t last, size_t grain_size, const std::function<void(size_t)>& fn)
+{
+    // Note: The upper half is spawned and the lower one split further, so the biggest parts end up at the front of the
+    // deque where thieves take from
+    while (last - first > grain_size)
+    {
+        const size_t middle = first + (last - first) / 2;
+        Spawn(group, [this, &group, middle, last, grain_size, &fn] { RunRange(group, middle, last, grain_size, fn); });
+        last = middle;
+    }
+
+    for (size_t i = first; i < last; ++i)
+        fn(i);
+}
+
+void ThreadPool::Spawn(TaskGroup& group, std::function<void()> task)
+{
+    ++group.pending_count;
+
+    TaskQueue& local = GetLocalQueue();
+    {
+        std::lock_guard<std::mutex> lock(local.mutex);
+        local.tasks.push_back({ std::move(task), &group });
+        ++queued_count;
+    }
+
+    WakeUp(false);
+}
+
+void ThreadPool::Wait(TaskGroup& group)
+{
+    TaskQueue& local = GetLocalQueue();
+    while (group.pending_count > 0)
+    {
+        if (RunNextTask(local))
+            continue;
+
+        // Note: Nothing left to take, the last tasks of the group are running elsewhere
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        ++sleeping_count;
+        wake_up.wait(lock, [&] { return group.pending_count == 0 || queued_count > 0; });
+        --sleeping_count;
+    }
+}
+
+ThreadPool::TaskQueue& ThreadPool::GetLocalQueue()
+{
+    return local_pool == this ? *queues[local_index] : *queues.back();
+}
+
+bool ThreadPool::RunNextTask(TaskQueue& local)
+{
+    Task task;
+    {
+        std::lock_guard<std::mutex> lock(local.mutex);
+        if (!local.tasks.empty())
+        {
+            task = std::move(local.tasks.back());
+            local.tasks.pop_back();
+            --queued_count;
+        }
+    }
+
+    if (!task.fn)
+    {
+        // Note: Starts at a random deque, so the thieves don't all line up at the same one
+        static thread_local std::minstd_rand random(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        const size_t first = random() % queues.size();
+        for (size_t i = 0; i < queues.size() && !task.fn; ++i)
+        {
+            TaskQueue& victim = *queues[(first + i) % queues.size()];
+            if (&victim == &local)
+                continue;
+
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                --queued_count;
+            }
+        }
+    }
+
+    if (!task.fn)
+        return false;
+
+    task.fn();
+
+    // Note: The group may be gone as soon as its count drops to 0, it isn't touched after that
+    if (--task.group->pending_count == 0)
+        WakeUp(true);
+    return true;
+}
+
+void ThreadPool::WakeUp(bool all)
+{
+    // Note: Sleepers count themselves before they check whether there's anything to do, so either they see the change
+    // which was made before this is called or they are seen here
+    if (sleeping_count == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(sleep_mutex);
+    if (all)
+        wake_up.notify_all();
+    else
+        wake_up.notify_one();
+}
+
+void ThreadPool::WorkerLoop(unsigned int index)
+{
+    local_pool = this;
+    local_index = index;
+
+    TaskQueue& local = *queues[index];
+    while (true)
+    {
+        if (RunNextTask(local))
+            continue;
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        ++sleeping_count;
+        wake_up.wait(lock, [this] { return stopping || queued_count > 0; });
+        --sleeping_count;
+        if (stopping && queued_count == 0)
+            return;
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads, one per core, shared by everything which wants to spread work across the machine
+// (loaders, converters, statistics, the CPU ray caster, ..). Use ThreadPool::Get() instead of creating pools of your
+// own, so we never oversubscribe.
+//
+// Note: The work is balanced by stealing. Every worker has a deque of its own, which the tasks it spawns go onto and
+// which it runs them from newest first (while their data is still in the cache). Workers which run out of tasks steal
+// the oldest ones of the others, which for work split in halves (see ParallelFor) are the biggest. Threads outside the
+// pool share one more deque.
+struct ThreadPool
+{
+    // Tasks which are waited for together, see Spawn and Wait
+    struct TaskGroup
+    {
+        std::atomic<size_t> pending_count = 0;
+    };
+
+    ThreadPool(unsigned int thread_count);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static ThreadPool& Get();
+
+    // Calls fn(i) for every i in [0, count) on the workers and the calling thread, returns once all calls are done. The
+    // range is split in halves down to `grain_size` indices, 0 picks a size which gives every thread 16 parts or so,
+    // pass 1 when the cost of the calls varies a lot.
+    // Note: The calling thread takes part in the work, so it is fine to call this from within a task.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& fn, size_t grain_size = 0);
+
+    // Queues `task` as part of `group` on the deque of the calling thread, any thread may end up running it. Tasks can
+    // spawn more tasks into their own group (or any other).
+    void Spawn(TaskGroup& group, std::function<void()> task);
+
+    // Returns once every task of `group` has run, including the ones spawned into it while waiting. The calling thread
+    // runs tasks in the meantime, so it is fine to call this from within a task.
+    void Wait(TaskGroup& group);
+
+    inline unsigned int GetThreadCount() const { return (unsigned int)workers.size() + 1; }
+
+private:
+    struct Task
+    {
+        std::function<void()> fn;
+        TaskGroup* group = nullptr;
+    };
+
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void WorkerLoop(unsigned int index);
+    void RunRange(TaskGroup& group, size_t first, size_t last, size_t grain_size, const std::function<void(size_t)>& fn);
+
+    // The deque the calling thread spawns onto
+    TaskQueue& GetLocalQueue();
+
+    // Runs the newest task of `local` or, if there is none, one stolen from another deque. False if there was none.
+    bool RunNextTask(TaskQueue& local);
+
+    // Wakes sleeping threads up after work got queued or a group finished, `all` of them for the latter as it's only
+    // of interest to the one waiting for that group
+    void WakeUp(bool all);
+
+    std::vector<std::thread> workers;
+
+    // One per worker, the last one is shared by the threads outside the pool
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+
+    // Tasks sitting in any of the deques
+    std::atomic<size_t> queued_count = 0;
+
+    std::atomic<unsigned int> sleeping_count = 0;
+    std::mutex sleep_mutex;
+    std::condition_variable wake_up;
+    bool stopping = false;
+};
+
+#define THREAD_POOL_H
+#endif
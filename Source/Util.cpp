@@ -40,6 +40,16 @@ std::vector<unsigned int> GetNDCQuadIndices()
     return std::vector<unsigned int>({ 0, 1, 2, 2, 3, 0 });
 }
 
+void LogLoadThroughput(const char* path, size_t byte_count, double seconds)
+{
+    const double megabytes = byte_count / (1024.0 * 1024.0);
+
+    std::ostringstream oss;
+    oss << "Loaded " << path << ": " << megabytes << " MB in " << seconds * 1000.0 << " ms ("
+        << (seconds > 0.0 ? megabytes / seconds : 0.0) << " MB/s)" << std::endl;
+    OutputDebugStringA(oss.str().c_str());
+}
+
 void GLClearErrors()
 {
     while (glGetError() != GL_NO_ERROR);
@@ -1,5 +1,6 @@
 #ifndef UTIL_H
 
+#include <cstddef>
 #include <vector>
 
 std::vector<float> GetUnitCubeVertices();
@@ -7,6 +8,9 @@ std::vector<unsigned int> GetUnitCubeIndices();
 std::vector<float> GetNDCQuadVertices();
 std::vector<unsigned int> GetNDCQuadIndices();
 
+// Writes "<path>: <size> MB in <time> ms (<throughput> MB/s)" to the debug output, handy for comparing loaders
+void LogLoadThroughput(const char* path, size_t byte_count, double seconds);
+
 //
 // OpenGL debugging stuff.
 //
@@ -1,32 +1,266 @@
 #include "Volume.h"
+#include "VolumeLoader.h"
+#include "BrickedVolume.h"
+#include "CompressedVolume.h"
+#include "SliceStack.h"
+#include "VolumeStatistics.h"
+#include "MinMaxGrid.h"
+#include "ThreadPool.h"
 #include "Core/Win32.h"
 
-#include <fstream>
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
 #include <sstream>
+#include <vector>
 
-Volume::Volume(const char* path, const glm::ivec3& dims, const glm::vec3& sp)
-    : dimensions(dims), spacing(sp)
+unsigned int GetDataTypeSize(VolumeDataType type)
 {
-    // Read in the volume data
-    std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
-    if (file.is_open())
+    switch (type)
     {
-        // Note: Position of the last character == size of the file
-        std::streampos pos = file.tellg();
-        char* data = new char[pos];
-        file.seekg(0, std::ios::beg);
-        file.read(data, pos);
-        file.close();
+        case VolumeDataType::UINT8: return 1u;
+        case VolumeDataType::UINT16: return 2u;
+        case VolumeDataType::INT16: return 2u;
+        case VolumeDataType::UINT32: return 4u;
+        case VolumeDataType::FLOAT16: return 2u;
+        case VolumeDataType::FLOAT32: return 4u;
+    }
 
-        // Upload to the GPU
-        texture = std::make_unique<Texture3D>(dimensions.x, dimensions.y, dimensions.z, GL_R8, GL_RED, GL_UNSIGNED_BYTE, data);
+    return 0u;
+}
 
-        delete[] data;
+const char* GetDataTypeName(VolumeDataType type)
+{
+    switch (type)
+    {
+        case VolumeDataType::UINT8: return "uint8";
+        case VolumeDataType::UINT16: return "uint16";
+        case VolumeDataType::INT16: return "int16";
+        case VolumeDataType::UINT32: return "uint32";
+        case VolumeDataType::FLOAT16: return "float16";
+        case VolumeDataType::FLOAT32: return "float32";
     }
-    else
+
+    return "unknown";
+}
+
+float GetVoxelValue(const unsigned char* voxel, VolumeDataType type)
+{
+    switch (type)
+    {
+        case VolumeDataType::UINT8:
+            return (float)voxel[0];
+
+        case VolumeDataType::UINT16:
+        {
+            uint16_t value;
+            memcpy(&value, voxel, sizeof(value));
+            return (float)value;
+        }
+
+        case VolumeDataType::INT16:
+        {
+            int16_t value;
+            memcpy(&value, voxel, sizeof(value));
+            return (float)value;
+        }
+
+        case VolumeDataType::UINT32:
+        {
+            uint32_t value;
+            memcpy(&value, voxel, sizeof(value));
+            return (float)value;
+        }
+
+        case VolumeDataType::FLOAT16:
+        {
+            uint16_t value;
+            memcpy(&value, voxel, sizeof(value));
+            return glm::unpackHalf1x16(value);
+        }
+
+        case VolumeDataType::FLOAT32:
+        {
+            float value;
+            memcpy(&value, voxel, sizeof(value));
+            return value;
+        }
+    }
+
+    return 0.f;
+}
+
+void SwapBytes(unsigned char* data, size_t size, unsigned int byte_count)
+{
+    if (byte_count < 2)
+        return;
+
+    for (size_t i = 0; i + byte_count <= size; i += byte_count)
+        std::reverse(data + i, data + i + byte_count);
+}
+
+glm::vec2 FindValueRange(const unsigned char* voxels, size_t voxel_count, VolumeDataType type)
+{
+    const size_t chunk_size = 1024 * 1024;
+    const size_t chunk_count = (voxel_count + chunk_size - 1) / chunk_size;
+    const unsigned int byte_count = GetDataTypeSize(type);
+
+    std::vector<glm::vec2> chunk_ranges(chunk_count, glm::vec2(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()));
+    ThreadPool::Get().ParallelFor(chunk_count, [&](size_t chunk)
+    {
+        const size_t end = std::min(voxel_count, (chunk + 1) * chunk_size);
+        glm::vec2& range = chunk_ranges[chunk];
+        for (size_t i = chunk * chunk_size; i < end; ++i)
+        {
+            const float value = GetVoxelValue(voxels + i * byte_count, type);
+            if (value == value)
+            {
+                range.x = std::min(range.x, value);
+                range.y = std::max(range.y, value);
+            }
+        }
+    });
+
+    glm::vec2 result(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest());
+    for (const glm::vec2& range : chunk_ranges)
+    {
+        result.x = std::min(result.x, range.x);
+        result.y = std::max(result.y, range.y);
+    }
+
+    return result;
+}
+
+const unsigned char* FindVoxelData(const MappedFile& file, const VolumeDesc& desc)
+{
+    if (!file.IsOpen())
+        return nullptr;
+
+    const size_t expected_size = desc.GetSize();
+
+    // Note: Validation only needs the size of the file, the voxels themselves are never read twice
+    const long long offset = (desc.data_offset < 0) ? (long long)file.size - (long long)expected_size : desc.data_offset;
+    if (offset < 0 || file.size < (size_t)offset + expected_size)
     {
         std::ostringstream oss;
-        oss << "Unable to open file at path: " << path << std::endl;
+        oss << "File at path: " << desc.path << " is " << file.size << " bytes, expected " << expected_size
+            << " bytes of voxels at offset " << offset << std::endl;
         OutputDebugStringA(oss.str().c_str());
+        return nullptr;
+    }
+
+    return file.data + offset;
+}
+
+bool ReadVoxelRegion(const VolumeDesc& desc, const unsigned char* data, const BrickedVolume* bricked, const CompressedVolume* compressed,
+    const SliceStack* slices, const glm::ivec3& begin, const glm::ivec3& end, unsigned char* dst)
+{
+    // Note: Bricked volumes are always little endian, and so are decoded images
+    if (bricked)
+        return bricked->ReadRegion(begin, end, dst);
+
+    if (slices)
+        return slices->ReadRegion(begin, end, dst);
+
+    const glm::ivec3 extent = end - begin;
+    const unsigned int byte_count = desc.GetByteCount();
+    const size_t row_size = (size_t)extent.x * byte_count;
+    const size_t slice_size = row_size * extent.y;
+    const size_t file_row_size = (size_t)desc.dimensions.x * byte_count;
+    const size_t file_slice_size = file_row_size * desc.dimensions.y;
+
+    // The part of every slice of the file which has to be read, from the first voxel of the region in it to the last
+    auto get_span_begin = [&](int z) { return (size_t)(begin.z + z) * file_slice_size + begin.y * file_row_size + begin.x * byte_count; };
+    const size_t span_size = (extent.y - 1) * file_row_size + row_size;
+
+    // Note: Without this the reads would page fault their way through the rows, one page at a time
+    if (data)
+    {
+        std::vector<WIN32_MEMORY_RANGE_ENTRY> ranges(extent.z);
+        for (int z = 0; z < extent.z; ++z)
+            ranges[z] = { (void*)(data + get_span_begin(z)), span_size };
+        PrefetchVirtualMemory(GetCurrentProcess(), ranges.size(), ranges.data(), 0);
     }
-}
\ No newline at end of file
+
+    std::atomic<bool> success = true;
+    ThreadPool::Get().ParallelFor(extent.z, [&](size_t z)
+    {
+        unsigned char* slice_dst = dst + z * slice_size;
+        const size_t span_begin = get_span_begin((int)z);
+
+        // Whole rows are contiguous in the file, anything narrower is read (or inflated) a span at a time and cropped
+        const unsigned char* span = nullptr;
+        if (compressed && extent.x == desc.dimensions.x)
+        {
+            if (!compressed->ReadRange(span_begin, span_begin + span_size, slice_dst))
+                success = false;
+        }
+        else if (compressed)
+        {
+            thread_local std::vector<unsigned char> inflated;
+            inflated.resize(span_size);
+            if (!compressed->ReadRange(span_begin, span_begin + span_size, inflated.data()))
+                success = false;
+            span = inflated.data();
+        }
+        else
+        {
+            span = data + span_begin;
+        }
+
+        if (span)
+        {
+            for (int y = 0; y < extent.y; ++y)
+                memcpy(slice_dst + y * row_size, span + y * file_row_size, row_size);
+        }
+
+        if (desc.big_endian)
+            SwapBytes(slice_dst, slice_size, byte_count);
+    });
+
+    return success;
+}
+
+Volume::Volume(std::unique_ptr<StagedVolume> staged)
+    : desc(staged->desc), file(std::move(staged->file)), data(staged->data), bricked(std::move(staged->bricked)),
+    compressed(std::move(staged->compressed)), slices(std::move(staged->slices)), region_begin(staged->region_begin), region_end(staged->region_end),
+    downsample_factor(staged->downsample_factor), texture(std::move(staged->texture)), data_range(staged->data_range),
+    statistics(std::make_unique<VolumeStatistics>(std::move(staged->statistics))),
+    min_max_grid(std::make_unique<MinMaxGrid>(std::move(staged->min_max_grid)))
+{
+    if (desc.data_type == VolumeDataType::UINT8)
+        value_range = glm::vec2(0.f, 255.f);
+    else if (desc.data_type == VolumeDataType::UINT16)
+        value_range = glm::vec2(0.f, 65535.f);
+    else
+        value_range = data_range;
+}
+
+// Note: Defined here, where BrickedVolume, CompressedVolume, SliceStack, VolumeStatistics and MinMaxGrid are complete types
+Volume::~Volume() = default;
+
+bool Volume::ReadRegion(const glm::ivec3& begin, const glm::ivec3& end, unsigned char* dst) const
+{
+    return ReadVoxelRegion(desc, data, bricked.get(), compressed.get(), slices.get(), begin, end, dst);
+}
+
+glm::vec2 Volume::GetValueRemap() const
+{
+    // Note: Normalized formats come out of the sampler divided by the largest value of their type
+    float texture_scale = 1.f;
+    if (desc.data_type == VolumeDataType::UINT8)
+        texture_scale = 255.f;
+    else if (desc.data_type == VolumeDataType::UINT16)
+        texture_scale = 65535.f;
+    else if (desc.data_type == VolumeDataType::INT16)
+        texture_scale = 32767.f;
+
+    // Note: An empty range (a constant volume) would divide by zero, everything maps to 0 instead
+    const float extent = value_range.y - value_range.x;
+    if (extent <= 0.f)
+        return glm::vec2(0.f);
+
+    return glm::vec2(texture_scale / extent, -value_range.x / extent);
+}
@@ -1,20 +1,130 @@
 #ifndef VOLUME_H
 
 #include "Texture3D.h"
+#include "MappedFile.h"
 
 #include <glm/glm.hpp>
+#include <cstdint>
 #include <memory>
+#include <string>
 
-// Note: I think there is no point in separating reading and uploading of volume, since, in almost
-// all cases we don't want to keep the volume around in CPU memory. Maybe this would change in the
-// future if I decide to implement texture streaming (virtual texturing) to deal with huge volumes.
+// Note: Stored as is in .bvol files, only ever append to this
+enum class VolumeDataType : uint32_t
+{
+    UINT8,
+    UINT16,
+    INT16,
+    UINT32,
+    FLOAT16,
+    FLOAT32
+};
+
+unsigned int GetDataTypeSize(VolumeDataType type);
+const char* GetDataTypeName(VolumeDataType type);
+
+// Reads a single (little endian) voxel
+float GetVoxelValue(const unsigned char* voxel, VolumeDataType type);
+
+// Reverses the byte order of every `byte_count` sized element in `data`
+void SwapBytes(unsigned char* data, size_t size, unsigned int byte_count);
+
+// Returns the smallest and the largest value among the voxels, NaNs are ignored. Runs in parallel.
+glm::vec2 FindValueRange(const unsigned char* voxels, size_t voxel_count, VolumeDataType type);
+
+enum class VolumeEncoding
+{
+    RAW,
+    GZIP,
+    ZLIB
+};
+
+// Everything needed to interpret a raw volume file
+struct VolumeDesc
+{
+    std::string path;
+    glm::ivec3 dimensions = glm::ivec3(256);
+    glm::vec3 spacing = glm::vec3(1.f);
+    VolumeDataType data_type = VolumeDataType::UINT8;
+
+    // Byte offset of the first voxel in the file, -1 means that the voxels are at the very end of the file (the
+    // convention of both NRRD and MetaImage for skipping a header of unknown size)
+    long long data_offset = 0;
+    bool big_endian = false;
+
+    // Note: For compressed encodings the voxels are the (inflated) data from `data_offset` to the end of the file
+    VolumeEncoding encoding = VolumeEncoding::RAW;
+
+    inline unsigned int GetByteCount() const { return GetDataTypeSize(data_type); }
+    inline size_t GetSize() const { return (size_t)dimensions.x * dimensions.y * dimensions.z * GetByteCount(); }
+};
+
+// Returns a pointer to the first voxel described by `desc` within the mapped file, or nullptr (with a message in the
+// debug output) if the file is too small for it
+const unsigned char* FindVoxelData(const MappedFile& file, const VolumeDesc& desc);
+
+struct StagedVolume;
+struct BrickedVolume;
+struct CompressedVolume;
+struct SliceStack;
+struct VolumeStatistics;
+struct MinMaxGrid;
+
+// Reads the voxels of the region [begin, end) of a volume into `dst`, tightly packed in X-major order and little
+// endian. The voxels come from whichever of `data` (the mapped file), `bricked`, `compressed` or `slices` isn't null,
+// and only the rows within the region are touched. Slices are read in parallel.
+bool ReadVoxelRegion(const VolumeDesc& desc, const unsigned char* data, const BrickedVolume* bricked, const CompressedVolume* compressed,
+    const SliceStack* slices, const glm::ivec3& begin, const glm::ivec3& end, unsigned char* dst);
+
+// Note: The volume file is memory mapped instead of read into a buffer, so the GPU upload is sourced directly from
+// the OS file cache and there is never a second copy of the volume in CPU memory. Keeping the mapping around is cheap
+// (the OS is free to evict the pages whenever it wants), and it gives CPU-side consumers access to the voxels.
 struct Volume
 {
-    Volume(const char* path, const glm::ivec3& dims, const glm::vec3& sp);
+    // Takes over the mapping and the texture of a volume which has been completely loaded by the VolumeLoader
+    Volume(std::unique_ptr<StagedVolume> staged);
+    ~Volume();
+
+    const VolumeDesc desc;
+    std::unique_ptr<MappedFile> file = nullptr;
+
+    // Voxels in X-major order pointing into the mapped file, nullptr for bricked, compressed and slice stack volumes
+    // whose voxels are only accessible through `bricked` (brick by brick), `compressed` (byte range by byte range) or
+    // `slices` (image by image, there is no mapped file at all)
+    const unsigned char* data = nullptr;
+    std::unique_ptr<BrickedVolume> bricked;
+    std::unique_ptr<CompressedVolume> compressed;
+    std::unique_ptr<SliceStack> slices;
 
-    const glm::ivec3 dimensions;
-    const glm::vec3 spacing;
+    // The region of interest of the volume which is in the texture, in voxels, [region_begin, region_end). The
+    // whole volume unless it was loaded with a region.
+    glm::ivec3 region_begin = glm::ivec3(0);
+    glm::ivec3 region_end = glm::ivec3(0);
+
+    // The region is downsampled by this factor in the texture if it didn't fit the texture limits
+    int downsample_factor = 1;
     std::unique_ptr<Texture3D> texture = nullptr;
+
+    // Smallest and largest voxel value, and the range of values the transfer function spans (which defaults to the
+    // whole range of the data type for 8 and 16 bit unsigned volumes, to the data range for everything else)
+    glm::vec2 data_range = glm::vec2(0.f);
+    glm::vec2 value_range = glm::vec2(0.f);
+
+    // Mean, standard deviation and histogram of the region, gathered while it was loaded
+    std::unique_ptr<VolumeStatistics> statistics;
+
+    // Value ranges of the bricks of the texture, the transfer function turns them into the occupancy of the bricks
+    std::unique_ptr<MinMaxGrid> min_max_grid;
+
+    // Scale and bias which map what the shader samples from the texture to [0, 1] over `value_range`. Normalization
+    // happens on the GPU, the texture always holds the voxels in their own data type.
+    glm::vec2 GetValueRemap() const;
+    inline bool IsIntegerTexture() const { return desc.data_type == VolumeDataType::UINT32; }
+
+    inline glm::ivec3 GetRegionExtent() const { return region_end - region_begin; }
+    inline glm::ivec3 GetTextureDimensions() const { return glm::ivec3(texture->width, texture->height, texture->depth); }
+
+    // Reads any region of the volume (not just the region of interest) straight from the file, see ReadVoxelRegion()
+    bool ReadRegion(const glm::ivec3& begin, const glm::ivec3& end, unsigned char* dst) const;
 };
 
 #define VOLUME_H
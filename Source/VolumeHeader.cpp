@@ -0,0 +1,358 @@
+#include "VolumeHeader.h"
+#include "Core/Win32.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+static std::string Trim(const std::string& str)
+{
+    const char* whitespace = " \t\r\n";
+    size_t first = str.find_first_not_of(whitespace);
+    if (first == std::string::npos)
+        return "";
+
+    size_t last = str.find_last_not_of(whitespace);
+    return str.substr(first, last - first + 1);
+}
+
+static std::string ToLower(std::string str)
+{
+    std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return str;
+}
+
+static std::string GetExtension(const std::string& path)
+{
+    return ToLower(std::filesystem::path(path).extension().string());
+}
+
+// Detached data files are given relative to the directory of the header
+static std::string ResolveDataPath(const std::string& header_path, const std::string& data_file)
+{
+    std::filesystem::path data_path(data_file);
+    if (data_path.is_absolute())
+        return data_path.string();
+
+    return (std::filesystem::path(header_path).parent_path() / data_path).string();
+}
+
+static bool HeaderError(const std::string& path, const std::string& message)
+{
+    std::ostringstream oss;
+    oss << "Unable to read volume header at path: " << path << ", " << message << std::endl;
+    OutputDebugStringA(oss.str().c_str());
+    return false;
+}
+
+// Returns false if the type isn't supported
+static bool GetNRRDDataType(const std::string& type, VolumeDataType& data_type)
+{
+    if (type == "uchar" || type == "unsigned char" || type == "uint8" || type == "uint8_t")
+        data_type = VolumeDataType::UINT8;
+    else if (type == "ushort" || type == "unsigned short" || type == "unsigned short int" || type == "uint16" || type == "uint16_t")
+        data_type = VolumeDataType::UINT16;
+    else if (type == "short" || type == "short int" || type == "signed short" || type == "signed short int" || type == "int16" || type == "int16_t")
+        data_type = VolumeDataType::INT16;
+    else if (type == "uint" || type == "unsigned int" || type == "uint32" || type == "uint32_t")
+        data_type = VolumeDataType::UINT32;
+    else if (type == "float")
+        data_type = VolumeDataType::FLOAT32;
+    else
+        return false;
+
+    return true;
+}
+
+static bool GetMetaImageDataType(const std::string& type, VolumeDataType& data_type)
+{
+    if (type == "MET_UCHAR")
+        data_type = VolumeDataType::UINT8;
+    else if (type == "MET_USHORT")
+        data_type = VolumeDataType::UINT16;
+    else if (type == "MET_SHORT")
+        data_type = VolumeDataType::INT16;
+    else if (type == "MET_UINT")
+        data_type = VolumeDataType::UINT32;
+    else if (type == "MET_FLOAT")
+        data_type = VolumeDataType::FLOAT32;
+    else
+        return false;
+
+    return true;
+}
+
+bool IsVolumeHeaderFile(const std::string& path)
+{
+    const std::string& extension = GetExtension(path);
+    return extension == ".nrrd" || extension == ".nhdr" || extension == ".mhd" || extension == ".mha";
+}
+
+bool ReadVolumeHeader(const std::string& path, VolumeDesc& desc)
+{
+    const std::string& extension = GetExtension(path);
+
+    if (extension == ".nrrd" || extension == ".nhdr")
+        return ReadNRRDHeader(path, desc);
+
+    if (extension == ".mhd" || extension == ".mha")
+        return ReadMetaImageHeader(path, desc);
+
+    return HeaderError(path, "unknown extension " + extension);
+}
+
+bool ReadNRRDHeader(const std::string& path, VolumeDesc& desc)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return HeaderError(path, "unable to open file");
+
+    std::string line;
+    std::getline(file, line);
+    if (line.compare(0, 4, "NRRD") != 0)
+        return HeaderError(path, "missing NRRD magic");
+
+    VolumeDesc result;
+    result.path = path;
+
+    std::string data_file;
+    long long line_skip = 0;
+    bool has_spacing = false;
+    bool attached_data = false;
+
+    while (std::getline(file, line))
+    {
+        line = Trim(line);
+
+        // Note: A blank line ends the header, the (attached) data begins right after it
+        if (line.empty())
+        {
+            attached_data = true;
+            break;
+        }
+
+        if (line[0] == '#')
+            continue;
+
+        // Note: Key/value pairs (key:=value) carry no information we need
+        size_t separator = line.find(": ");
+        if (separator == std::string::npos || line.find(":=") != std::string::npos)
+            continue;
+
+        const std::string field = ToLower(Trim(line.substr(0, separator)));
+        const std::string value = Trim(line.substr(separator + 2));
+        std::istringstream iss(value);
+
+        if (field == "type")
+        {
+            if (!GetNRRDDataType(ToLower(value), result.data_type))
+                return HeaderError(path, "unsupported type " + value);
+        }
+        else if (field == "dimension")
+        {
+            int dimension = 0;
+            iss >> dimension;
+            if (dimension != 3)
+                return HeaderError(path, "only 3 dimensional volumes are supported");
+        }
+        else if (field == "sizes")
+        {
+            iss >> result.dimensions.x >> result.dimensions.y >> result.dimensions.z;
+        }
+        else if (field == "spacings")
+        {
+            iss >> result.spacing.x >> result.spacing.y >> result.spacing.z;
+            has_spacing = true;
+        }
+        else if (field == "space directions" && !has_spacing)
+        {
+            // Note: Spacing is the length of each of the axis vectors, like "(0.5,0,0) (0,0.5,0) (0,0,1)"
+            std::string vector;
+            for (int axis = 0; axis < 3 && (iss >> vector); ++axis)
+            {
+                std::replace(vector.begin(), vector.end(), ',', ' ');
+                vector.erase(std::remove(vector.begin(), vector.end(), '('), vector.end());
+                vector.erase(std::remove(vector.begin(), vector.end(), ')'), vector.end());
+
+                glm::vec3 direction(0.f);
+                std::istringstream(vector) >> direction.x >> direction.y >> direction.z;
+                result.spacing[axis] = glm::length(direction);
+            }
+        }
+        else if (field == "encoding")
+        {
+            const std::string encoding = ToLower(value);
+            if (encoding == "gzip" || encoding == "gz")
+                result.encoding = VolumeEncoding::GZIP;
+            else if (encoding != "raw")
+                return HeaderError(path, "unsupported encoding " + value);
+        }
+        else if (field == "endian")
+        {
+            result.big_endian = ToLower(value) == "big";
+        }
+        else if (field == "byte skip")
+        {
+            iss >> result.data_offset;
+        }
+        else if (field == "line skip")
+        {
+            iss >> line_skip;
+        }
+        else if (field == "data file" || field == "datafile")
+        {
+            data_file = value;
+            if (data_file.find(' ') != std::string::npos || ToLower(data_file) == "list")
+                return HeaderError(path, "multi-file data isn't supported");
+        }
+    }
+
+    // Note: Byte skip is relative to where the data begins, which is right after the header for attached data, and
+    // after the skipped lines (if any)
+    long long data_begin = 0;
+    if (!data_file.empty())
+    {
+        result.path = ResolveDataPath(path, data_file);
+    }
+    else
+    {
+        if (!attached_data)
+            return HeaderError(path, "no data file and no attached data");
+
+        data_begin = (long long)file.tellg();
+    }
+
+    if (line_skip > 0)
+    {
+        std::ifstream data(result.path, std::ios::in | std::ios::binary);
+        data.seekg(data_begin);
+        for (long long i = 0; i < line_skip; ++i)
+            data.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+        if (!data)
+            return HeaderError(path, "data file is shorter than the line skip");
+
+        data_begin = (long long)data.tellg();
+    }
+
+    if (result.data_offset >= 0)
+        result.data_offset += data_begin;
+    else if (result.encoding != VolumeEncoding::RAW)
+        return HeaderError(path, "byte skip -1 is only valid for raw encoding");
+
+    if (glm::any(glm::lessThanEqual(result.dimensions, glm::ivec3(0))))
+        return HeaderError(path, "missing or invalid sizes");
+
+    desc = result;
+    return true;
+}
+
+bool ReadMetaImageHeader(const std::string& path, VolumeDesc& desc)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return HeaderError(path, "unable to open file");
+
+    VolumeDesc result;
+    result.path = path;
+
+    std::string data_file;
+    bool has_dimensions = false;
+    bool has_spacing = false;
+    bool has_type = false;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        size_t separator = line.find('=');
+        if (separator == std::string::npos)
+            continue;
+
+        const std::string key = Trim(line.substr(0, separator));
+        const std::string value = Trim(line.substr(separator + 1));
+        std::istringstream iss(value);
+
+        if (key == "NDims")
+        {
+            int dimension = 0;
+            iss >> dimension;
+            if (dimension != 3)
+                return HeaderError(path, "only 3 dimensional volumes are supported");
+        }
+        else if (key == "DimSize")
+        {
+            iss >> result.dimensions.x >> result.dimensions.y >> result.dimensions.z;
+            has_dimensions = true;
+        }
+        else if (key == "ElementSpacing")
+        {
+            iss >> result.spacing.x >> result.spacing.y >> result.spacing.z;
+            has_spacing = true;
+        }
+        else if (key == "ElementSize" && !has_spacing)
+        {
+            iss >> result.spacing.x >> result.spacing.y >> result.spacing.z;
+        }
+        else if (key == "ElementType")
+        {
+            if (!GetMetaImageDataType(value, result.data_type))
+                return HeaderError(path, "unsupported element type " + value);
+            has_type = true;
+        }
+        else if (key == "ElementNumberOfChannels")
+        {
+            int channels = 1;
+            iss >> channels;
+            if (channels != 1)
+                return HeaderError(path, "only scalar volumes are supported");
+        }
+        else if (key == "ElementByteOrderMSB" || key == "BinaryDataByteOrderMSB")
+        {
+            result.big_endian = ToLower(value) == "true";
+        }
+        else if (key == "CompressedData")
+        {
+            if (ToLower(value) == "true")
+                result.encoding = VolumeEncoding::ZLIB;
+        }
+        else if (key == "HeaderSize")
+        {
+            iss >> result.data_offset;
+        }
+        else if (key == "ElementDataFile")
+        {
+            // Note: ElementDataFile is always the last field, for LOCAL the data begins on the next line
+            data_file = value;
+            break;
+        }
+    }
+
+    if (data_file.empty())
+        return HeaderError(path, "missing ElementDataFile");
+
+    if (result.data_offset < 0 && result.encoding != VolumeEncoding::RAW)
+        return HeaderError(path, "HeaderSize -1 is only valid for uncompressed data");
+
+    if (data_file == "LOCAL")
+    {
+        if (result.data_offset >= 0)
+            result.data_offset += (long long)file.tellg();
+    }
+    else if (data_file == "LIST" || data_file.find('%') != std::string::npos)
+    {
+        return HeaderError(path, "multi-file data isn't supported");
+    }
+    else
+    {
+        result.path = ResolveDataPath(path, data_file);
+    }
+
+    if (!has_dimensions || !has_type || glm::any(glm::lessThanEqual(result.dimensions, glm::ivec3(0))))
+        return HeaderError(path, "missing or invalid DimSize or ElementType");
+
+    desc = result;
+    return true;
+}
@@ -0,0 +1,19 @@
+#ifndef VOLUME_HEADER_H
+
+#include "Volume.h"
+
+// Readers for volume formats which describe themselves in a text header, so the user doesn't have to type in
+// dimensions, spacing and data type. They only parse the header, the voxels are left to the VolumeLoader which maps
+// the data file and streams it straight into the upload buffers from `desc.data_offset` onwards.
+//
+// Supported:
+//  -> NRRD (.nrrd with attached data, .nhdr with detached data), raw or gzip encoding
+//  -> MetaImage (.mha with local data, .mhd with detached data), uncompressed or zlib compressed
+bool IsVolumeHeaderFile(const std::string& path);
+bool ReadVolumeHeader(const std::string& path, VolumeDesc& desc);
+
+bool ReadNRRDHeader(const std::string& path, VolumeDesc& desc);
+bool ReadMetaImageHeader(const std::string& path, VolumeDesc& desc);
+
+#define VOLUME_HEADER_H
+#endif
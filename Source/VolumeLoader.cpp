@@ -0,0 +1,535 @@
+#include "VolumeLoader.h"
+#include "VolumeHeader.h"
+#include "CompressedVolume.h"
+#include "ThreadPool.h"
+#include "Downsample.h"
+#include "VolumeStatistics.h"
+#include "Util.h"
+#include "Core/Win32.h"
+
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+// Note: Everything but the 32 bit unsigned integers can be sampled (and filtered) as floats
+void GetTextureFormat(VolumeDataType data_type, GLenum& internal_format, GLenum& format, GLenum& type)
+{
+    format = GL_RED;
+    switch (data_type)
+    {
+        case VolumeDataType::UINT8: internal_format = GL_R8; type = GL_UNSIGNED_BYTE; break;
+        case VolumeDataType::UINT16: internal_format = GL_R16; type = GL_UNSIGNED_SHORT; break;
+        case VolumeDataType::INT16: internal_format = GL_R16_SNORM; type = GL_SHORT; break;
+        case VolumeDataType::UINT32: internal_format = GL_R32UI; format = GL_RED_INTEGER; type = GL_UNSIGNED_INT; break;
+        case VolumeDataType::FLOAT16: internal_format = GL_R16F; type = GL_HALF_FLOAT; break;
+        case VolumeDataType::FLOAT32: internal_format = GL_R32F; type = GL_FLOAT; break;
+    }
+}
+
+static void ConvertFloat32ToFloat16(const unsigned char* src, unsigned char* dst, size_t voxel_count)
+{
+    const size_t chunk_size = 1024 * 1024;
+    ThreadPool::Get().ParallelFor((voxel_count + chunk_size - 1) / chunk_size, [&](size_t chunk)
+    {
+        const size_t end = std::min(voxel_count, (chunk + 1) * chunk_size);
+        for (size_t i = chunk * chunk_size; i < end; ++i)
+        {
+            float value;
+            memcpy(&value, src + i * sizeof(value), sizeof(value));
+            const uint16_t half = (uint16_t)glm::packHalf1x16(value);
+            memcpy(dst + i * sizeof(half), &half, sizeof(half));
+        }
+    });
+}
+
+VolumeLoader::~VolumeLoader()
+{
+    Cancel();
+}
+
+void VolumeLoader::Load(const VolumeDesc& desc, const VolumeLoadOptions& options)
+{
+    Cancel();
+
+    current_path = desc.path;
+    begin = std::chrono::high_resolution_clock::now();
+    cancel_requested = false;
+    validated = false;
+    staging_done = false;
+    failed = false;
+    progress = 0.f;
+    loading = true;
+    worker = std::thread(&VolumeLoader::Stage, this, desc, options);
+}
+
+void VolumeLoader::Cancel()
+{
+    cancel_requested = true;
+    {
+        std::lock_guard<std::mutex> lock(uploader_mutex);
+        if (uploader)
+            uploader->Abort();
+    }
+    uploader_created.notify_all();
+    Join();
+
+    uploader = nullptr;
+    staged = nullptr;
+    complete = nullptr;
+    loading = false;
+}
+
+void VolumeLoader::Update(size_t upload_budget)
+{
+    if (!loading)
+        return;
+
+    if (failed)
+    {
+        Join();
+
+        // Note: The uploader streams into the texture of the staged volume, so it has to go first
+        {
+            std::lock_guard<std::mutex> lock(uploader_mutex);
+            uploader = nullptr;
+        }
+        staged = nullptr;
+        loading = false;
+        return;
+    }
+
+    if (validated && !uploader)
+    {
+        const glm::ivec3 extent = staged->texture_dimensions;
+        GLenum internal_format, format, type;
+        GetTextureFormat(staged->texture_type, internal_format, format, type);
+        staged->texture = CreateVolumeTexture(extent, staged->texture_type, staged->mip_level_count);
+
+        // Note: Aligning the slabs to the bricks means every brick gets decompressed exactly once, unless that would
+        // make the PBOs huge (very large slices), then we'd rather decompress some of the bricks more than once
+        const unsigned int texture_byte_count = GetDataTypeSize(staged->texture_type);
+        const size_t slice_size = (size_t)extent.x * extent.y * texture_byte_count;
+        int depth_alignment = 1;
+        if (staged->bricked && staged->bricked->brick_size * slice_size <= 64 * 1024 * 1024)
+            depth_alignment = staged->bricked->brick_size;
+
+        // Note: Slices of a stack are decoded in parallel within a slab, so a slab should have a slice for every thread
+        size_t slab_size = 16 * 1024 * 1024;
+        if (staged->slices)
+            slab_size = std::clamp(ThreadPool::Get().GetThreadCount() * slice_size, slab_size, (size_t)128 * 1024 * 1024);
+
+        std::lock_guard<std::mutex> lock(uploader_mutex);
+        // Note: The statistics and the min-max grid read the voxels back out of the slabs
+        uploader = std::make_unique<SlabUploader>(*staged->texture, format, type, texture_byte_count, depth_alignment, slab_size, 3, true);
+        uploader_created.notify_all();
+    }
+
+    if (uploader)
+    {
+        uploader->Update(upload_budget);
+        progress = uploader->GetProgress();
+
+        // Note: The worker may still be building the mip levels after the last slab is in
+        if (uploader->IsDone() && staging_done)
+        {
+            Join();
+            uploader = nullptr;
+
+            // The mip levels together are a seventh of level 0, so they just go in in one go
+            if (!staged->mip_levels.empty())
+            {
+                GLenum internal_format, format, type;
+                GetTextureFormat(staged->texture_type, internal_format, format, type);
+
+                staged->texture->Bind();
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                glm::ivec3 dimensions = staged->texture_dimensions;
+                for (size_t i = 0; i < staged->mip_levels.size(); ++i)
+                {
+                    dimensions = GetDownsampledDimensions(dimensions, 2);
+                    glTexSubImage3D(GL_TEXTURE_3D, (GLint)i + 1, 0, 0, 0, dimensions.x, dimensions.y, dimensions.z, format, type, staged->mip_levels[i].data());
+                }
+                staged->texture->Unbind();
+                staged->mip_levels.clear();
+            }
+
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - begin;
+            const glm::ivec3 extent = staged->region_end - staged->region_begin;
+            LogLoadThroughput(staged->desc.path.c_str(), (size_t)extent.x * extent.y * extent.z * staged->desc.GetByteCount(), elapsed.count());
+
+            complete = std::move(staged);
+            loading = false;
+        }
+    }
+}
+
+std::unique_ptr<StagedVolume> VolumeLoader::TakeStaged()
+{
+    return std::move(complete);
+}
+
+void VolumeLoader::Join()
+{
+    if (worker.joinable())
+        worker.join();
+}
+
+// Adds voxels of the volume to its statistics, the data range follows along (unless the bricks had it already)
+static void AccumulateStatistics(StagedVolume& volume, const unsigned char* voxels, size_t voxel_count)
+{
+    volume.statistics.Accumulate(voxels, voxel_count, volume.desc.data_type);
+    if (volume.statistics.count > 0 && !volume.bricked)
+        volume.data_range = volume.statistics.GetRange();
+}
+
+// Reads the voxels which end up in the slices [z_begin, z_end) of the texture of a volume downsampled by `factor` into
+// `dst`, in the data type of the file. The region is read a few slices at a time through `scratch`, so it stays small
+// no matter how large the factor is. The statistics are taken from the full resolution voxels.
+static bool ReadDownsampledSlices(StagedVolume& volume, int factor, int z_begin, int z_end, unsigned char* dst,
+    std::vector<unsigned char>& scratch, bool accumulate_statistics)
+{
+    const VolumeDesc& desc = volume.desc;
+    const unsigned int byte_count = desc.GetByteCount();
+    const glm::ivec3 extent = volume.region_end - volume.region_begin;
+    const glm::ivec3 dimensions = GetDownsampledDimensions(extent, factor);
+    const size_t src_slice_size = (size_t)extent.x * extent.y * byte_count;
+    const size_t dst_slice_size = (size_t)dimensions.x * dimensions.y * byte_count;
+    const int chunk_depth = (int)std::max<size_t>(1, 64 * 1024 * 1024 / (src_slice_size * factor));
+
+    bool success = true;
+    for (int z = z_begin; z < z_end; z += chunk_depth)
+    {
+        // Note: The last slice of the texture also takes in the slices left over by the division
+        const int chunk_end = std::min(z + chunk_depth, z_end);
+        const glm::ivec3 begin(volume.region_begin.x, volume.region_begin.y, volume.region_begin.z + z * factor);
+        const glm::ivec3 end(volume.region_end.x, volume.region_end.y,
+            (chunk_end == dimensions.z) ? volume.region_end.z : volume.region_begin.z + chunk_end * factor);
+
+        const size_t voxel_count = (size_t)extent.x * extent.y * (end.z - begin.z);
+        scratch.resize(voxel_count * byte_count);
+        if (!ReadVoxelRegion(desc, volume.data, volume.bricked.get(), volume.compressed.get(), volume.slices.get(), begin, end, scratch.data()))
+        {
+            std::ostringstream oss;
+            oss << "Corrupt voxel data in volume at path: " << desc.path << std::endl;
+            OutputDebugStringA(oss.str().c_str());
+            success = false;
+        }
+
+        if (accumulate_statistics)
+            AccumulateStatistics(volume, scratch.data(), voxel_count);
+
+        DownsampleVolume(scratch.data(), glm::ivec3(extent.x, extent.y, end.z - begin.z), desc.data_type, factor, dst + (z - z_begin) * dst_slice_size);
+    }
+
+    return success;
+}
+
+// Fills in the mip levels of an opened volume. Level 1 comes straight from the file downsampled by twice the factor of
+// level 0, which gives the same dimensions as halving level 0 but filters the full resolution voxels. The levels
+// after it are halved from the one above.
+static bool BuildMipLevels(StagedVolume& volume, std::vector<unsigned char>& scratch)
+{
+    const int factor = volume.downsample_factor * 2;
+    const glm::ivec3 dimensions = GetDownsampledDimensions(volume.region_end - volume.region_begin, factor);
+    const VolumeDataType data_type = volume.desc.data_type;
+
+    std::vector<unsigned char> level((size_t)dimensions.x * dimensions.y * dimensions.z * GetDataTypeSize(data_type));
+    if (!ReadDownsampledSlices(volume, factor, 0, dimensions.z, level.data(), scratch, false))
+        return false;
+
+    volume.mip_levels = BuildMipChain(level.data(), dimensions, data_type);
+    volume.mip_levels.insert(volume.mip_levels.begin(), std::move(level));
+
+    if (volume.texture_type != data_type)
+    {
+        for (std::vector<unsigned char>& mip_level : volume.mip_levels)
+        {
+            const size_t voxel_count = mip_level.size() / GetDataTypeSize(data_type);
+            std::vector<unsigned char> converted(voxel_count * GetDataTypeSize(volume.texture_type));
+            ConvertFloat32ToFloat16(mip_level.data(), converted.data(), voxel_count);
+            mip_level = std::move(converted);
+        }
+    }
+
+    return true;
+}
+
+void VolumeLoader::Stage(VolumeDesc desc, VolumeLoadOptions options)
+{
+    auto result = std::make_unique<StagedVolume>();
+    if (!OpenVolume(desc, options, *result))
+    {
+        failed = true;
+        return;
+    }
+
+    StagedVolume* volume = result.get();
+    staged = std::move(result);
+    validated = true;
+
+    // Wait for the render thread to create the texture and the uploader
+    {
+        std::unique_lock<std::mutex> lock(uploader_mutex);
+        uploader_created.wait(lock, [&] { return uploader != nullptr || cancel_requested; });
+    }
+
+    // Note: Copying out of the mapping is what actually reads the file from disk, and it happens while the render
+    // thread is uploading the previously filled slabs. The render thread only looks at the data range after joining
+    // the worker.
+    std::vector<unsigned char> scratch;
+    Slab slab;
+    while (!cancel_requested && uploader->AcquireSlab(slab))
+    {
+        // Note: A volume which can't be read completely is dropped, the previous one stays on screen
+        if (!ReadSlab(*volume, slab, scratch))
+        {
+            std::ostringstream oss;
+            oss << "Failed to read slices " << slab.z_begin << " to " << slab.z_begin + slab.depth << " of " << volume->desc.path << ", the load is cancelled" << std::endl;
+            OutputDebugStringA(oss.str().c_str());
+
+            failed = true;
+            return;
+        }
+        uploader->SubmitSlab(slab);
+    }
+
+    if (!cancel_requested && volume->mip_level_count > 1)
+    {
+        auto mip_begin = std::chrono::high_resolution_clock::now();
+        if (BuildMipLevels(*volume, scratch))
+        {
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - mip_begin;
+            std::ostringstream oss;
+            oss << "Built " << volume->mip_level_count - 1 << " mip levels of " << volume->desc.path << " in " << elapsed.count() * 1000.0 << " ms" << std::endl;
+            OutputDebugStringA(oss.str().c_str());
+        }
+        else
+        {
+            // Note: The texture is still complete without them, it just samples level 0 throughout
+            volume->mip_levels.clear();
+        }
+    }
+
+    staging_done = true;
+}
+
+std::unique_ptr<Texture3D> CreateVolumeTexture(const glm::ivec3& dimensions, VolumeDataType texture_type, int level_count)
+{
+    GLenum internal_format, format, type;
+    GetTextureFormat(texture_type, internal_format, format, type);
+
+    auto texture = std::make_unique<Texture3D>(dimensions.x, dimensions.y, dimensions.z, internal_format, level_count);
+    if (format == GL_RED_INTEGER)
+    {
+        // Note: Integer textures are incomplete with linear filtering, the shader filters them itself
+        texture->Bind();
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        texture->Unbind();
+    }
+
+    return texture;
+}
+
+bool OpenVolume(VolumeDesc desc, const VolumeLoadOptions& options, StagedVolume& result)
+{
+    if (IsVolumeHeaderFile(desc.path) && !ReadVolumeHeader(desc.path, desc))
+        return false;
+
+    if (desc.encoding == VolumeEncoding::RAW && IsGzipFile(desc.path))
+        desc.encoding = VolumeEncoding::GZIP;
+
+    // Note: Cropping raw files reads the file in a scattered way, everything else is read front to back anyway (in
+    // the case of bricked files because every brick overlapping the region has to be decompressed)
+    const bool cropped = glm::any(glm::lessThan(options.region_begin, options.region_end));
+
+    const bool slice_stack = IsSliceStackDirectory(desc.path);
+
+    result.desc = desc;
+    if (!slice_stack)
+        result.file = std::make_unique<MappedFile>(desc.path.c_str(), !cropped);
+
+    if (slice_stack)
+    {
+        // Note: Nothing is mapped, the slices are decoded one image file at a time
+        result.slices = std::make_unique<SliceStack>();
+        if (!result.slices->Open(desc.path, desc))
+            return false;
+
+        result.desc = desc;
+    }
+    else if (IsBrickedVolumeFile(desc.path))
+    {
+        result.bricked = std::make_unique<BrickedVolume>();
+        if (!result.file->IsOpen() || !result.bricked->Open(result.file->data, result.file->size))
+        {
+            std::ostringstream oss;
+            oss << "Not a valid bricked volume at path: " << desc.path << std::endl;
+            OutputDebugStringA(oss.str().c_str());
+            return false;
+        }
+
+        result.bricked->desc.path = desc.path;
+        result.desc = desc = result.bricked->desc;
+    }
+    else if (desc.encoding != VolumeEncoding::RAW)
+    {
+        const MappedFile& file = *result.file;
+        result.compressed = std::make_unique<CompressedVolume>();
+        if (!file.IsOpen() || desc.data_offset < 0 || (size_t)desc.data_offset >= file.size
+            || !result.compressed->Open(file.data + desc.data_offset, file.size - (size_t)desc.data_offset, desc))
+            return false;
+    }
+    else
+    {
+        result.data = FindVoxelData(*result.file, desc);
+        if (!result.data)
+            return false;
+    }
+
+    result.size = desc.GetSize();
+    result.region_begin = glm::ivec3(0);
+    result.region_end = desc.dimensions;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (options.region_begin[axis] < options.region_end[axis])
+        {
+            result.region_begin[axis] = std::clamp(options.region_begin[axis], 0, desc.dimensions[axis] - 1);
+            result.region_end[axis] = std::clamp(options.region_end[axis], result.region_begin[axis] + 1, desc.dimensions[axis]);
+        }
+    }
+
+    result.texture_type = desc.data_type;
+    if (options.float32_to_float16 && desc.data_type == VolumeDataType::FLOAT32)
+        result.texture_type = VolumeDataType::FLOAT16;
+
+    // Note: The smallest factor which fits, so we keep as much of the resolution as we can. The mip chain adds another
+    // seventh of level 0 on top.
+    const glm::ivec3 extent = result.region_end - result.region_begin;
+    const unsigned int texture_byte_count = GetDataTypeSize(result.texture_type);
+    for (result.downsample_factor = 1; ; ++result.downsample_factor)
+    {
+        const glm::ivec3 dimensions = GetDownsampledDimensions(extent, result.downsample_factor);
+        size_t texture_size = (size_t)dimensions.x * dimensions.y * dimensions.z * texture_byte_count;
+        if (options.generate_mipmaps)
+            texture_size += texture_size / 7;
+
+        const bool too_large = (options.max_texture_size > 0 && glm::any(glm::greaterThan(dimensions, glm::ivec3(options.max_texture_size))))
+            || (options.memory_budget > 0 && texture_size > options.memory_budget);
+        if (!too_large || dimensions == glm::ivec3(1))
+            break;
+    }
+
+    result.texture_dimensions = GetDownsampledDimensions(extent, result.downsample_factor);
+    result.mip_level_count = options.generate_mipmaps ? GetMipLevelCount(result.texture_dimensions) : 1;
+
+    if (result.downsample_factor > 1)
+    {
+        std::ostringstream oss;
+        oss << "Downsampling " << desc.path << " by " << result.downsample_factor << " to " << result.texture_dimensions.x << "x"
+            << result.texture_dimensions.y << "x" << result.texture_dimensions.z << " to fit the texture limits" << std::endl;
+        OutputDebugStringA(oss.str().c_str());
+    }
+
+    // Note: Bricks know their value range already, everything else gets it from the statistics slab by slab on the way
+    // to the GPU
+    result.data_range = glm::vec2(0.f);
+    if (result.bricked)
+    {
+        result.data_range = glm::vec2(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest());
+        for (size_t i = 0; i < result.bricked->GetBrickCount(); ++i)
+        {
+            const glm::ivec3 origin = result.bricked->GetBrickOrigin(i);
+            const glm::ivec3 extent = result.bricked->GetBrickExtent(i);
+            if (glm::any(glm::greaterThanEqual(origin, result.region_end)) || glm::any(glm::lessThanEqual(origin + extent, result.region_begin)))
+                continue;
+
+            result.data_range.x = std::min(result.data_range.x, result.bricked->bricks[i].min);
+            result.data_range.y = std::max(result.data_range.y, result.bricked->bricks[i].max);
+        }
+    }
+    result.min_max_grid = MinMaxGrid(result.texture_dimensions);
+
+    return true;
+}
+
+bool ReadSlab(StagedVolume& volume, const Slab& slab, std::vector<unsigned char>& scratch)
+{
+    const VolumeDesc& desc = volume.desc;
+    const bool convert = volume.texture_type != desc.data_type;
+
+    // Note: Downsampled straight into the slab if it can be read back, the min-max grid has to look at the voxels again.
+    // Otherwise (and to be converted) into a buffer of its own first.
+    if (volume.downsample_factor > 1)
+    {
+        const size_t voxel_count = (size_t)volume.texture_dimensions.x * volume.texture_dimensions.y * slab.depth;
+
+        thread_local std::vector<unsigned char> downsampled;
+        unsigned char* dst = slab.data;
+        if (convert || !slab.readable)
+        {
+            downsampled.resize(voxel_count * desc.GetByteCount());
+            dst = downsampled.data();
+        }
+
+        const bool success = ReadDownsampledSlices(volume, volume.downsample_factor, slab.z_begin, slab.z_begin + slab.depth, dst, scratch, true);
+        if (!volume.min_max_grid.ranges.empty())
+            volume.min_max_grid.Accumulate(dst, slab.z_begin, slab.depth, desc.data_type);
+
+        if (convert)
+            ConvertFloat32ToFloat16(dst, slab.data, voxel_count);
+        else if (dst != slab.data)
+            memcpy(slab.data, dst, voxel_count * desc.GetByteCount());
+
+        return success;
+    }
+
+    const unsigned int byte_count = desc.GetByteCount();
+    const glm::ivec3 begin(volume.region_begin.x, volume.region_begin.y, volume.region_begin.z + slab.z_begin);
+    const glm::ivec3 end(volume.region_end.x, volume.region_end.y, begin.z + slab.depth);
+    const size_t voxel_count = (size_t)(end.x - begin.x) * (end.y - begin.y) * slab.depth;
+    const size_t slab_size = voxel_count * byte_count;
+
+    const bool whole_slices = begin.x == 0 && begin.y == 0 && end.x == desc.dimensions.x && end.y == desc.dimensions.y;
+
+    // Note: Whole slices of raw little endian files are copied straight out of the mapping. Everything else is read
+    // straight into the slab, where the statistics and the min-max grid look at the voxels afterwards. Only if the slab
+    // can't be read back quickly (or the voxels are converted on the way) does it go through `scratch` first.
+    const unsigned char* src = nullptr;
+    if (volume.data && whole_slices && !desc.big_endian)
+        src = volume.data + (size_t)begin.z * desc.dimensions.x * desc.dimensions.y * byte_count;
+
+    bool success = true;
+    if (!src)
+    {
+        unsigned char* dst = slab.data;
+        if (convert || !slab.readable)
+        {
+            scratch.resize(slab_size);
+            dst = scratch.data();
+        }
+
+        if (!ReadVoxelRegion(desc, volume.data, volume.bricked.get(), volume.compressed.get(), volume.slices.get(), begin, end, dst))
+        {
+            std::ostringstream oss;
+            oss << "Corrupt voxel data in volume at path: " << desc.path << std::endl;
+            OutputDebugStringA(oss.str().c_str());
+            success = false;
+        }
+        src = dst;
+    }
+
+    AccumulateStatistics(volume, src, voxel_count);
+    if (!volume.min_max_grid.ranges.empty())
+        volume.min_max_grid.Accumulate(src, slab.z_begin, slab.depth, desc.data_type);
+
+    if (convert)
+        ConvertFloat32ToFloat16(src, slab.data, voxel_count);
+    else if (src != slab.data)
+        memcpy(slab.data, src, slab_size);
+
+    return success;
+}
@@ -0,0 +1,138 @@
+#ifndef VOLUME_LOADER_H
+
+#include "Volume.h"
+#include "MappedFile.h"
+#include "SlabUploader.h"
+#include "BrickedVolume.h"
+#include "CompressedVolume.h"
+#include "SliceStack.h"
+#include "VolumeStatistics.h"
+#include "MinMaxGrid.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A volume which has been read in by the loader and uploaded to the GPU, ready to be swapped in
+struct StagedVolume
+{
+    VolumeDesc desc;
+    std::unique_ptr<MappedFile> file = nullptr;
+
+    // Voxels in X-major order, points into the mapped file (nullptr for bricked, compressed and slice stack volumes)
+    const unsigned char* data = nullptr;
+    std::unique_ptr<BrickedVolume> bricked = nullptr;
+    std::unique_ptr<CompressedVolume> compressed = nullptr;
+    std::unique_ptr<SliceStack> slices = nullptr;
+    size_t size = 0;
+
+    // The region of the volume which goes into the texture, [region_begin, region_end) in voxels
+    glm::ivec3 region_begin = glm::ivec3(0);
+    glm::ivec3 region_end = glm::ivec3(0);
+
+    // The region is downsampled by this factor along every axis on its way into the texture if it is too large for
+    // it, see VolumeLoadOptions
+    int downsample_factor = 1;
+    glm::ivec3 texture_dimensions = glm::ivec3(0);
+
+    // The data type of the texture, which differs from the one of the file only if it was converted on load
+    VolumeDataType texture_type = VolumeDataType::UINT8;
+    std::unique_ptr<Texture3D> texture = nullptr;
+
+    // Levels 1 and up of the texture, in the texture type, only there if the full mip chain was asked for
+    int mip_level_count = 1;
+    std::vector<std::vector<unsigned char>> mip_levels;
+
+    // Smallest and largest voxel value, and the rest of the value distribution of the region
+    glm::vec2 data_range = glm::vec2(0.f);
+    VolumeStatistics statistics;
+
+    // Value ranges of the bricks of the texture (level 0), for empty space skipping. Left empty by VolumeSequence.
+    MinMaxGrid min_max_grid;
+};
+
+struct VolumeLoadOptions
+{
+    // Halves the GPU memory of float32 volumes, at the cost of precision (and range, float16 tops out at 65504)
+    bool float32_to_float16 = false;
+
+    // Only the region [region_begin, region_end) of the volume is read and uploaded, it is clamped to the volume and
+    // an empty range on an axis (the default) means the whole axis
+    glm::ivec3 region_begin = glm::ivec3(0);
+    glm::ivec3 region_end = glm::ivec3(0);
+
+    // Regions which don't fit the texture limits, `max_texture_size` voxels along any axis (GL_MAX_3D_TEXTURE_SIZE)
+    // or `memory_budget` bytes, are downsampled on load by the smallest factor which makes them fit. 0 means no limit.
+    // Note: GL_MAX_3D_TEXTURE_SIZE has to be queried on the thread which owns the context, not by the loader
+    int max_texture_size = 0;
+    size_t memory_budget = 0;
+
+    // Builds the full mip chain of the texture on the CPU, which means reading the volume a second time. Ignored by
+    // VolumeSequence.
+    bool generate_mipmaps = false;
+};
+
+// Loads volumes without ever blocking the render thread on the disk.
+//
+// A worker thread maps and validates the file, then streams it slab by slab into the PBOs of a SlabUploader. The
+// render thread calls Update() once per frame, which creates the (empty) texture once the file has been validated
+// and uploads filled slabs within the given budget. Meanwhile the previous volume keeps being rendered, TakeStaged()
+// hands out the new one once it has been completely uploaded.
+struct VolumeLoader
+{
+    ~VolumeLoader();
+
+    // Starts loading a new volume in the background, cancelling the one in flight (if any)
+    void Load(const VolumeDesc& desc, const VolumeLoadOptions& options = {});
+    void Cancel();
+
+    void Update(size_t upload_budget);
+
+    inline bool IsLoading() const { return loading; }
+    inline float GetProgress() const { return progress; }
+    inline const std::string& GetPath() const { return current_path; }
+
+    // Returns the staged volume exactly once after it is completely uploaded, nullptr otherwise
+    std::unique_ptr<StagedVolume> TakeStaged();
+
+private:
+    void Stage(VolumeDesc desc, VolumeLoadOptions options);
+    void Join();
+
+    std::thread worker;
+    std::atomic<bool> loading = false;
+    std::atomic<bool> validated = false;
+    std::atomic<bool> staging_done = false;
+    std::atomic<bool> failed = false;
+    std::atomic<bool> cancel_requested = false;
+    std::atomic<float> progress = 0.f;
+    std::string current_path;
+    std::chrono::high_resolution_clock::time_point begin;
+
+    // Note: Owned by the worker until `validated` is set, from then on the worker only reads the voxels from it
+    std::unique_ptr<StagedVolume> staged = nullptr;
+    std::unique_ptr<StagedVolume> complete = nullptr;
+
+    std::mutex uploader_mutex;
+    std::condition_variable uploader_created;
+    std::unique_ptr<SlabUploader> uploader = nullptr;
+};
+
+// The steps of loading a volume, for streaming volumes into textures other than the loader's own
+
+void GetTextureFormat(VolumeDataType data_type, GLenum& internal_format, GLenum& format, GLenum& type);
+std::unique_ptr<Texture3D> CreateVolumeTexture(const glm::ivec3& dimensions, VolumeDataType texture_type, int level_count = 1);
+
+// Reads the header (if any), maps the file and validates it, without reading any of the voxels
+bool OpenVolume(VolumeDesc desc, const VolumeLoadOptions& options, StagedVolume& result);
+
+// Fills a slab with the voxels of an opened volume, converted to the texture type, and adds them to its statistics and
+// its min-max grid (if it has one). `scratch` is reused from slab to slab.
+bool ReadSlab(StagedVolume& volume, const Slab& slab, std::vector<unsigned char>& scratch);
+
+#define VOLUME_LOADER_H
+#endif
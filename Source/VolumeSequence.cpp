@@ -0,0 +1,366 @@
+#include "VolumeSequence.h"
+#include "Core/Win32.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <sstream>
+
+// Note: The request handed from the render thread to the prefetch thread goes through these states
+enum
+{
+    REQUEST_IDLE,
+    REQUEST_PENDING,
+    REQUEST_OPENED,
+    REQUEST_STREAMING,
+    REQUEST_FAILED
+};
+
+std::vector<std::string> FindVolumeSequence(const std::string& path)
+{
+    const std::filesystem::path file_path(path);
+    const std::string file_name = file_path.filename().string();
+
+    // The step number is the last run of digits in the file name
+    size_t digits_end = file_name.find_last_of("0123456789");
+    if (digits_end == std::string::npos)
+        return { path };
+    ++digits_end;
+
+    size_t digits_begin = digits_end;
+    while (digits_begin > 0 && std::isdigit((unsigned char)file_name[digits_begin - 1]))
+        --digits_begin;
+
+    const std::string prefix = file_name.substr(0, digits_begin);
+    const std::string suffix = file_name.substr(digits_end);
+
+    std::vector<std::pair<unsigned long long, std::string>> steps;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(file_path.parent_path().empty() ? "." : file_path.parent_path(), error))
+    {
+        const std::string name = entry.path().filename().string();
+        if (!entry.is_regular_file() || name.size() <= prefix.size() + suffix.size()
+            || name.compare(0, prefix.size(), prefix) != 0 || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+            continue;
+
+        const std::string number = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+        if (number.size() > 18 || !std::all_of(number.begin(), number.end(), [](unsigned char c) { return std::isdigit(c); }))
+            continue;
+
+        steps.emplace_back(std::stoull(number), entry.path().string());
+    }
+
+    if (steps.size() < 2)
+        return { path };
+
+    std::sort(steps.begin(), steps.end());
+
+    std::vector<std::string> result;
+    for (const auto& step : steps)
+        result.push_back(step.second);
+
+    return result;
+}
+
+VolumeSequence::VolumeSequence(const std::vector<std::string>& paths, const VolumeDesc& desc, const VolumeLoadOptions& options, unsigned int slot_count)
+    : paths(paths), desc(desc), options(options), slots(std::max(2u, slot_count)), broken_steps(paths.size(), false)
+{
+    prefetch_thread = std::thread(&VolumeSequence::Prefetch, this);
+}
+
+VolumeSequence::~VolumeSequence()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+        if (uploader)
+            uploader->Abort();
+    }
+    request_changed.notify_all();
+
+    if (prefetch_thread.joinable())
+        prefetch_thread.join();
+}
+
+void VolumeSequence::Update(double delta_time, size_t upload_budget)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (request_state == REQUEST_FAILED)
+        {
+            broken_steps[requested_step] = true;
+            loading_slot->state = SlotState::FREE;
+            loading_slot = nullptr;
+            request_state = REQUEST_IDLE;
+        }
+        else if (request_state == REQUEST_OPENED)
+        {
+            // Note: The textures are created once the first step is opened, that's when we know what they look like
+            if (!uploader)
+            {
+                texture_dimensions = opened_dimensions;
+                texture_type = opened_texture_type;
+                for (Slot& slot : slots)
+                    slot.texture = CreateVolumeTexture(texture_dimensions, texture_type);
+
+                GLenum internal_format, format, type;
+                GetTextureFormat(texture_type, internal_format, format, type);
+                uploader = std::make_unique<SlabUploader>(*loading_slot->texture, format, type, GetDataTypeSize(texture_type));
+                request_state = REQUEST_STREAMING;
+            }
+            else if (opened_dimensions != texture_dimensions || opened_texture_type != texture_type)
+            {
+                std::ostringstream oss;
+                oss << "Skipping step " << requested_step << " of the sequence, " << paths[requested_step]
+                    << " doesn't match the dimensions or data type of the other steps" << std::endl;
+                OutputDebugStringA(oss.str().c_str());
+
+                broken_steps[requested_step] = true;
+                loading_slot->state = SlotState::FREE;
+                loading_slot = nullptr;
+                request_state = REQUEST_IDLE;
+            }
+            else
+            {
+                uploader->Restart(*loading_slot->texture);
+                request_state = REQUEST_STREAMING;
+            }
+        }
+    }
+    request_changed.notify_all();
+
+    if (uploader)
+    {
+        // Note: Called even when nothing is streaming, that's what recycles the PBOs
+        uploader->Update(upload_budget);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (request_state == REQUEST_STREAMING && uploader->IsDone())
+        {
+            if (stream_failed)
+            {
+                std::ostringstream oss;
+                oss << "Skipping step " << requested_step << " of the sequence, " << paths[requested_step] << " could not be read" << std::endl;
+                OutputDebugStringA(oss.str().c_str());
+
+                broken_steps[requested_step] = true;
+                loading_slot->state = SlotState::FREE;
+                stream_failed = false;
+            }
+            else
+            {
+                loading_slot->state = SlotState::READY;
+            }
+            loading_slot = nullptr;
+            request_state = REQUEST_IDLE;
+        }
+    }
+
+    // Playback only moves on once the step on screen is the one it asked for, so it never runs ahead of the loading
+    const double step_duration = 1.0 / std::max(steps_per_second, 0.01f);
+    if (playing)
+    {
+        time_since_step = std::min(time_since_step + delta_time, step_duration);
+        if (time_since_step >= step_duration && target_step == displayed_step)
+        {
+            const int next_step = GetNextStep(target_step);
+            if (next_step < 0)
+            {
+                playing = false;
+            }
+            else
+            {
+                target_step = next_step;
+                time_since_step -= step_duration;
+            }
+        }
+    }
+
+    if (broken_steps[target_step])
+    {
+        const int next_step = GetNextStep(target_step);
+        if (next_step >= 0)
+            target_step = next_step;
+    }
+
+    const Slot* target_slot = FindSlot(target_step);
+    if (target_slot && target_slot->state == SlotState::READY)
+        displayed_step = target_step;
+
+    StartNextLoad();
+}
+
+void VolumeSequence::Seek(int step)
+{
+    target_step = std::clamp(step, 0, GetStepCount() - 1);
+    time_since_step = 0.0;
+}
+
+const Texture3D* VolumeSequence::GetTexture() const
+{
+    for (const Slot& slot : slots)
+    {
+        if (slot.step == displayed_step && slot.state == SlotState::READY)
+            return slot.texture.get();
+    }
+
+    return nullptr;
+}
+
+int VolumeSequence::GetPrefetchedStepCount() const
+{
+    int count = 0;
+    for (int step = GetNextStep(displayed_step); step >= 0 && step != displayed_step && count < (int)slots.size(); step = GetNextStep(step))
+    {
+        const Slot* slot = FindSlot(step);
+        if (!slot || slot->state != SlotState::READY)
+            break;
+        ++count;
+    }
+
+    return count;
+}
+
+int VolumeSequence::GetNextStep(int step) const
+{
+    const int step_count = GetStepCount();
+    for (int i = 0; i < step_count; ++i)
+    {
+        step += direction;
+        if (step < 0 || step >= step_count)
+        {
+            if (!loop)
+                return -1;
+            step = (step + step_count) % step_count;
+        }
+
+        if (!broken_steps[step])
+            return step;
+    }
+
+    return -1;
+}
+
+const VolumeSequence::Slot* VolumeSequence::FindSlot(int step) const
+{
+    for (const Slot& slot : slots)
+    {
+        if (slot.step == step && slot.state != SlotState::FREE)
+            return &slot;
+    }
+
+    return nullptr;
+}
+
+void VolumeSequence::StartNextLoad()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (request_state != REQUEST_IDLE)
+        return;
+
+    // The steps we want to have around: the target step and the ones after it, every slot but the one on screen
+    std::vector<int> wanted_steps;
+    for (int step = target_step; step >= 0 && wanted_steps.size() + 1 < slots.size(); step = GetNextStep(step))
+    {
+        if (std::find(wanted_steps.begin(), wanted_steps.end(), step) != wanted_steps.end())
+            break;
+
+        if (step != displayed_step && !broken_steps[step])
+            wanted_steps.push_back(step);
+    }
+
+    for (int step : wanted_steps)
+    {
+        if (FindSlot(step))
+            continue;
+
+        // Note: Steps which are neither on screen nor wanted anymore are overwritten, free slots first
+        Slot* slot = nullptr;
+        for (Slot& candidate : slots)
+        {
+            const bool is_wanted = std::find(wanted_steps.begin(), wanted_steps.end(), candidate.step) != wanted_steps.end();
+            if (candidate.state == SlotState::FREE || (candidate.step != displayed_step && !is_wanted))
+            {
+                slot = &candidate;
+                if (candidate.state == SlotState::FREE)
+                    break;
+            }
+        }
+
+        if (!slot)
+            return;
+
+        slot->step = step;
+        slot->state = SlotState::LOADING;
+        loading_slot = slot;
+        requested_step = step;
+        request_state = REQUEST_PENDING;
+
+        lock.unlock();
+        request_changed.notify_all();
+        return;
+    }
+}
+
+void VolumeSequence::Prefetch()
+{
+    std::vector<unsigned char> scratch;
+    while (true)
+    {
+        int step;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            request_changed.wait(lock, [&] { return quit || request_state == REQUEST_PENDING; });
+            if (quit)
+                return;
+
+            step = requested_step;
+        }
+
+        VolumeDesc step_desc = desc;
+        step_desc.path = paths[step];
+
+        // Note: Empty space skipping is off while a sequence plays, so the steps don't need a min-max grid
+        StagedVolume volume;
+        const bool opened = OpenVolume(step_desc, options, volume);
+        volume.min_max_grid = MinMaxGrid();
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (!opened)
+            {
+                request_state = REQUEST_FAILED;
+                continue;
+            }
+
+            opened_dimensions = volume.texture_dimensions;
+            opened_texture_type = volume.texture_type;
+            request_state = REQUEST_OPENED;
+
+            // Wait for the render thread to point the uploader at the texture of the slot (or to reject the step)
+            request_changed.wait(lock, [&] { return quit || request_state != REQUEST_OPENED; });
+            if (quit)
+                return;
+
+            if (request_state != REQUEST_STREAMING || requested_step != step)
+                continue;
+        }
+
+        // Note: The uploader only ever changes while no request is streaming, and it outlives this thread. A step which
+        // fails to read is still streamed to the end (without reading any further), since the uploader has to be done
+        // with one texture before it moves on to the next, but the render thread drops it rather than showing it.
+        bool read_failed = false;
+        Slab slab;
+        while (uploader->AcquireSlab(slab))
+        {
+            if (!read_failed && !ReadSlab(volume, slab, scratch))
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                read_failed = true;
+                stream_failed = true;
+            }
+            uploader->SubmitSlab(slab);
+        }
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef VOLUME_SEQUENCE_H
+
+#include "VolumeLoader.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Returns the numbered sequence of files `path` is a part of, sorted by number, for instance "run_0007.raw" finds
+// every "run_<number>.raw" in the same directory. The result is just `path` if it isn't numbered.
+std::vector<std::string> FindVolumeSequence(const std::string& path);
+
+// Plays back a time-varying volume, a sequence of volumes with the same dimensions and data type, one per step.
+//
+// Every step gets streamed into one of a few texture slots which are allocated once and then rotate: one of them is
+// being rendered, the others hold (or are receiving) the next steps in the play direction. A prefetch thread reads
+// the steps ahead of time into the PBOs of a single SlabUploader which the render thread drains in Update(), so
+// reading step N+2 and uploading step N+1 overlaps rendering step N. Playback never waits on the disk, if the next
+// step isn't there yet the current one just stays on screen a little longer.
+//
+// Note: The constructor, destructor and Update() must be called on the thread which owns the OpenGL context
+struct VolumeSequence
+{
+    // `desc` describes every step but the path, header files are read for every step
+    VolumeSequence(const std::vector<std::string>& paths, const VolumeDesc& desc, const VolumeLoadOptions& options, unsigned int slot_count = 3);
+    ~VolumeSequence();
+
+    VolumeSequence(const VolumeSequence&) = delete;
+    VolumeSequence& operator=(const VolumeSequence&) = delete;
+
+    // Advances the playback by `delta_time` seconds and uploads prefetched steps within the budget
+    void Update(double delta_time, size_t upload_budget);
+
+    // Shows the given step as soon as it is uploaded, and plays on from there
+    void Seek(int step);
+
+    // The texture of the step on screen, nullptr until the first step has been uploaded
+    const Texture3D* GetTexture() const;
+
+    inline int GetStep() const { return displayed_step; }
+    inline int GetTargetStep() const { return target_step; }
+    inline int GetStepCount() const { return (int)paths.size(); }
+    inline const std::string& GetPath(int step) const { return paths[step]; }
+
+    // Number of steps ahead of the one on screen which are ready to be shown
+    int GetPrefetchedStepCount() const;
+
+    bool playing = false;
+    bool loop = true;
+    int direction = 1;
+    float steps_per_second = 30.f;
+
+private:
+    enum class SlotState
+    {
+        FREE,
+        LOADING,
+        READY
+    };
+
+    struct Slot
+    {
+        std::unique_ptr<Texture3D> texture;
+        int step = -1;
+        SlotState state = SlotState::FREE;
+    };
+
+    // Returns the step after `step` in the play direction, -1 at the end of the sequence (unless looping)
+    int GetNextStep(int step) const;
+    const Slot* FindSlot(int step) const;
+    void StartNextLoad();
+    void Prefetch();
+
+    const std::vector<std::string> paths;
+    const VolumeDesc desc;
+    const VolumeLoadOptions options;
+
+    std::vector<Slot> slots;
+    glm::ivec3 texture_dimensions = glm::ivec3(0);
+    VolumeDataType texture_type = VolumeDataType::UINT8;
+    std::unique_ptr<SlabUploader> uploader = nullptr;
+    Slot* loading_slot = nullptr;
+
+    int displayed_step = -1;
+    int target_step = 0;
+    double time_since_step = 0.0;
+
+    // Steps which failed to load are skipped from then on
+    std::vector<bool> broken_steps;
+
+    // Note: The render thread hands one step at a time to the prefetch thread, which opens it and reports back what it
+    // found, then the render thread points the uploader at the texture of the slot and the prefetch thread streams it
+    std::thread prefetch_thread;
+    std::mutex mutex;
+    std::condition_variable request_changed;
+    int request_state = 0;
+    int requested_step = -1;
+    glm::ivec3 opened_dimensions = glm::ivec3(0);
+    VolumeDataType opened_texture_type = VolumeDataType::UINT8;
+    bool stream_failed = false;
+    bool quit = false;
+};
+
+#define VOLUME_SEQUENCE_H
+#endif
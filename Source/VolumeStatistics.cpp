@@ -0,0 +1,379 @@
+#include "VolumeStatistics.h"
+#include "ThreadPool.h"
+
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// Note: SSE2 is part of every x64 CPU, so it doesn't need a runtime check
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define STATISTICS_SSE2
+#endif
+
+#define FINE_BIN_COUNT 65536
+
+// 32 bit voxels are converted to float a block at a time, small enough to stay in L1
+#define BLOCK_SIZE 1024
+
+// Every fine bin of the 8 and 16 bit data types holds a single value, so everything else can be derived from the bins
+static inline bool HasExactBins(VolumeDataType type)
+{
+    return type != VolumeDataType::UINT32 && type != VolumeDataType::FLOAT32;
+}
+
+// The order preserving bit patterns flip every bit of negative values and just the sign bit of positive ones
+static inline uint32_t GetFloatKey(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return ((bits & 0x80000000u) ? ~bits : (bits | 0x80000000u)) >> 16;
+}
+
+static inline uint32_t GetHalfKey(uint16_t bits)
+{
+    return (bits & 0x8000u) ? (~bits & 0xFFFFu) : (bits | 0x8000u);
+}
+
+static inline float GetFloatFromPattern(uint32_t pattern)
+{
+    const uint32_t bits = (pattern & 0x80000000u) ? (pattern & 0x7FFFFFFFu) : ~pattern;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// The smallest and the largest value which fall into a fine bin, they are the same for exact bins
+static glm::vec2 GetKeyBounds(uint32_t key, VolumeDataType type)
+{
+    switch (type)
+    {
+        case VolumeDataType::UINT8:
+        case VolumeDataType::UINT16:
+            return glm::vec2((float)key);
+
+        case VolumeDataType::INT16:
+            return glm::vec2((float)((int)key - 32768));
+
+        case VolumeDataType::FLOAT16:
+            return glm::vec2(glm::unpackHalf1x16((uint16_t)((key & 0x8000u) ? (key & 0x7FFFu) : (~key & 0xFFFFu))));
+
+        case VolumeDataType::UINT32:
+        case VolumeDataType::FLOAT32:
+            return glm::vec2(GetFloatFromPattern(key << 16), GetFloatFromPattern((key << 16) | 0xFFFFu));
+    }
+
+    return glm::vec2(0.f);
+}
+
+// What a single thread accumulates before it is merged into the statistics
+struct PartialStatistics
+{
+    std::vector<uint32_t> bins;
+    size_t count = 0;
+    float min = std::numeric_limits<float>::max();
+    float max = std::numeric_limits<float>::lowest();
+    double mean = 0.0;
+    double m2 = 0.0;
+};
+
+// Adds `other_count` values with the given mean and M2 to the moments of `count` values (Chan et al.)
+static inline void MergeMoments(size_t& count, double& mean, double& m2, size_t other_count, double other_mean, double other_m2)
+{
+    if (other_count == 0)
+        return;
+
+    const size_t total = count + other_count;
+    const double delta = other_mean - mean;
+    mean += delta * ((double)other_count / (double)total);
+    m2 += other_m2 + delta * delta * ((double)count * (double)other_count / (double)total);
+    count = total;
+}
+
+static void CountExact(const unsigned char* voxels, size_t count, VolumeDataType type, uint32_t* bins)
+{
+    switch (type)
+    {
+        case VolumeDataType::UINT8:
+        {
+            // Note: Spread over four sets of bins, runs of the same value would otherwise wait on their own increments
+            uint32_t counts[4][256] = {};
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                ++counts[0][voxels[i]];
+                ++counts[1][voxels[i + 1]];
+                ++counts[2][voxels[i + 2]];
+                ++counts[3][voxels[i + 3]];
+            }
+            for (; i < count; ++i)
+                ++counts[0][voxels[i]];
+
+            for (int value = 0; value < 256; ++value)
+                bins[value] += counts[0][value] + counts[1][value] + counts[2][value] + counts[3][value];
+            break;
+        }
+
+        case VolumeDataType::UINT16:
+        case VolumeDataType::INT16:
+        {
+            const uint16_t flip = (type == VolumeDataType::INT16) ? 0x8000u : 0u;
+            for (size_t i = 0; i < count; ++i)
+            {
+                uint16_t bits;
+                memcpy(&bits, voxels + i * 2, sizeof(bits));
+                ++bins[bits ^ flip];
+            }
+            break;
+        }
+
+        case VolumeDataType::FLOAT16:
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                uint16_t bits;
+                memcpy(&bits, voxels + i * 2, sizeof(bits));
+                if ((bits & 0x7FFFu) <= 0x7C00u)
+                    ++bins[GetHalfKey(bits)];
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+static void ConvertBlock(const unsigned char* voxels, size_t count, VolumeDataType type, float* values)
+{
+    if (type == VolumeDataType::FLOAT32)
+    {
+        memcpy(values, voxels, count * sizeof(float));
+        return;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t value;
+        memcpy(&value, voxels + i * sizeof(value), sizeof(value));
+        values[i] = (float)value;
+    }
+}
+
+// Min, max and the moments of a block of 32 bit voxels. The block is summed up in double (its mean first, then the
+// squared differences from it, which the block being in L1 makes cheap) and then merged into the part.
+static void AccumulateMoments(const float* values, size_t count, PartialStatistics& part)
+{
+    size_t block_count = 0;
+    double sum = 0.0;
+    size_t i = 0;
+#ifdef STATISTICS_SSE2
+    // Note: NaNs fail the ordered comparison, they are masked out of the sums and min/max pick the other operand
+    static const int bit_counts[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+    __m128 min4 = _mm_set1_ps(part.min);
+    __m128 max4 = _mm_set1_ps(part.max);
+    __m128d sum2 = _mm_setzero_pd();
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 value = _mm_loadu_ps(values + i);
+        const __m128 ordered = _mm_cmpord_ps(value, value);
+        const __m128 masked = _mm_and_ps(value, ordered);
+        min4 = _mm_min_ps(value, min4);
+        max4 = _mm_max_ps(value, max4);
+        sum2 = _mm_add_pd(sum2, _mm_add_pd(_mm_cvtps_pd(masked), _mm_cvtps_pd(_mm_movehl_ps(masked, masked))));
+        block_count += bit_counts[_mm_movemask_ps(ordered)];
+    }
+
+    float mins[4], maxs[4];
+    double sums[2];
+    _mm_storeu_ps(mins, min4);
+    _mm_storeu_ps(maxs, max4);
+    _mm_storeu_pd(sums, sum2);
+    for (int lane = 0; lane < 4; ++lane)
+    {
+        part.min = std::min(part.min, mins[lane]);
+        part.max = std::max(part.max, maxs[lane]);
+    }
+    sum = sums[0] + sums[1];
+#endif
+
+    for (; i < count; ++i)
+    {
+        const float value = values[i];
+        if (value != value)
+            continue;
+
+        part.min = std::min(part.min, value);
+        part.max = std::max(part.max, value);
+        sum += value;
+        ++block_count;
+    }
+
+    if (block_count == 0)
+        return;
+
+    const double mean = sum / (double)block_count;
+    double m2 = 0.0;
+    i = 0;
+#ifdef STATISTICS_SSE2
+    const __m128d mean2 = _mm_set1_pd(mean);
+    __m128d m2_2 = _mm_setzero_pd();
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 value = _mm_loadu_ps(values + i);
+        const __m128 ordered = _mm_cmpord_ps(value, value);
+        const __m128d low_ordered = _mm_castps_pd(_mm_unpacklo_ps(ordered, ordered));
+        const __m128d high_ordered = _mm_castps_pd(_mm_unpackhi_ps(ordered, ordered));
+        const __m128d low = _mm_and_pd(_mm_sub_pd(_mm_cvtps_pd(value), mean2), low_ordered);
+        const __m128d high = _mm_and_pd(_mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(value, value)), mean2), high_ordered);
+        m2_2 = _mm_add_pd(m2_2, _mm_add_pd(_mm_mul_pd(low, low), _mm_mul_pd(high, high)));
+    }
+
+    double m2s[2];
+    _mm_storeu_pd(m2s, m2_2);
+    m2 = m2s[0] + m2s[1];
+#endif
+
+    for (; i < count; ++i)
+    {
+        const double value = values[i];
+        if (value == value)
+            m2 += (value - mean) * (value - mean);
+    }
+
+    MergeMoments(part.count, part.mean, part.m2, block_count, mean, m2);
+}
+
+static void CountFloatKeys(const float* values, size_t count, uint32_t* bins)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (values[i] == values[i])
+            ++bins[GetFloatKey(values[i])];
+    }
+}
+
+void VolumeStatistics::Accumulate(const unsigned char* voxels, size_t voxel_count, VolumeDataType type)
+{
+    if (bins.empty())
+    {
+        bins.assign(FINE_BIN_COUNT, 0);
+        data_type = type;
+    }
+
+    // One part per thread, the bins of a part have to fit into 32 bits though
+    const unsigned int byte_count = GetDataTypeSize(type);
+    const size_t min_part_size = 64 * 1024;
+    const size_t max_part_size = std::numeric_limits<uint32_t>::max();
+    size_t part_count = std::min<size_t>(ThreadPool::Get().GetThreadCount(), (voxel_count + min_part_size - 1) / min_part_size);
+    part_count = std::max(part_count, (voxel_count + max_part_size - 1) / max_part_size);
+    if (part_count == 0)
+        return;
+
+    const bool exact = HasExactBins(type);
+    std::vector<PartialStatistics> parts(part_count);
+    ThreadPool::Get().ParallelFor(part_count, [&](size_t p)
+    {
+        PartialStatistics& part = parts[p];
+        part.bins.assign(FINE_BIN_COUNT, 0);
+
+        const size_t begin = p * voxel_count / part_count;
+        const size_t end = (p + 1) * voxel_count / part_count;
+        if (exact)
+        {
+            CountExact(voxels + begin * byte_count, end - begin, type, part.bins.data());
+            return;
+        }
+
+        float values[BLOCK_SIZE];
+        for (size_t block = begin; block < end; block += BLOCK_SIZE)
+        {
+            const size_t count = std::min<size_t>(BLOCK_SIZE, end - block);
+            ConvertBlock(voxels + block * byte_count, count, type, values);
+            AccumulateMoments(values, count, part);
+            CountFloatKeys(values, count, part.bins.data());
+        }
+    });
+
+    for (PartialStatistics& part : parts)
+    {
+        // Note: Walking the bins in order visits the values in order, so min and max are the first and last bin. Every
+        // exact bin is a run of the same value, which merges in with an M2 of 0.
+        for (uint32_t key = 0; key < FINE_BIN_COUNT; ++key)
+        {
+            const uint32_t key_count = part.bins[key];
+            if (key_count == 0)
+                continue;
+
+            bins[key] += key_count;
+            if (exact)
+            {
+                const float value = GetKeyBounds(key, type).x;
+                part.min = std::min(part.min, value);
+                part.max = std::max(part.max, value);
+                MergeMoments(part.count, part.mean, part.m2, key_count, value, 0.0);
+            }
+        }
+
+        if (part.count == 0)
+            continue;
+
+        min = (count == 0) ? part.min : std::min(min, part.min);
+        max = (count == 0) ? part.max : std::max(max, part.max);
+        MergeMoments(count, mean, m2, part.count, part.mean, part.m2);
+    }
+}
+
+std::vector<float> VolumeStatistics::GetHistogram(int bin_count, const glm::vec2& range) const
+{
+    std::vector<float> histogram(bin_count, 0.f);
+    if (bins.empty() || count == 0 || !(range.y > range.x))
+        return histogram;
+
+    const double scale = (double)bin_count / ((double)range.y - range.x);
+    auto get_bin = [&](double value) { return std::clamp((int)((value - range.x) * scale), 0, bin_count - 1); };
+
+    for (uint32_t key = 0; key < FINE_BIN_COUNT; ++key)
+    {
+        if (bins[key] == 0)
+            continue;
+
+        // Note: Fine bins which span more than a value are spread evenly over the bins they overlap, or else wide
+        // fine bins would show up as spikes. The voxels are known to be within [min, max], so that's the span.
+        glm::vec2 bounds = GetKeyBounds(key, data_type);
+        bounds = glm::clamp(glm::vec2(std::min(bounds.x, bounds.y), std::max(bounds.x, bounds.y)), min, max);
+        if (bounds.y < range.x || bounds.x > range.y)
+            continue;
+
+        if (bounds.x == bounds.y)
+        {
+            histogram[get_bin(bounds.x)] += (float)bins[key];
+            continue;
+        }
+
+        const double width = (double)bounds.y - bounds.x;
+        const double begin = std::max((double)bounds.x, (double)range.x);
+        const double end = std::min((double)bounds.y, (double)range.y);
+        for (int bin = get_bin(begin); bin <= get_bin(end); ++bin)
+        {
+            const double bin_begin = range.x + bin / scale;
+            const double overlap = std::min(end, bin_begin + 1.0 / scale) - std::max(begin, bin_begin);
+            if (overlap > 0.0)
+                histogram[bin] += (float)(bins[key] * overlap / width);
+        }
+    }
+
+    return histogram;
+}
+
+double VolumeStatistics::GetMean() const
+{
+    return mean;
+}
+
+double VolumeStatistics::GetStandardDeviation() const
+{
+    return (count > 0) ? std::sqrt(m2 / (double)count) : 0.0;
+}
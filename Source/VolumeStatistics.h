@@ -0,0 +1,42 @@
+#ifndef VOLUME_STATISTICS_H
+
+#include "Volume.h"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Value distribution of a volume: min, max, mean, standard deviation and a histogram, built up slab by slab as the
+// volume streams in.
+//
+// Voxels are counted into 2^16 fine bins keyed by the top 16 bits of their order preserving bit pattern, which is
+// exact for the 8 and 16 bit data types and has a relative resolution of 2^-7 for 32 bit ones. Display histograms of
+// any size and range are rebinned from those, so the range doesn't have to be known before the voxels are seen.
+// NaNs are left out of everything.
+//
+// Note: The moments are kept as the mean and the sum of squared differences from it (M2), merged from part to part with
+// Chan's formula, so the variance doesn't come out of the difference of two huge sums which cancel each other out
+struct VolumeStatistics
+{
+    // Adds the voxels (little endian) to the statistics. Every thread of the pool counts a part of them into bins of
+    // its own, which are summed up at the end, so no atomics in the inner loop.
+    void Accumulate(const unsigned char* voxels, size_t voxel_count, VolumeDataType type);
+
+    // Voxel counts of `bin_count` bins evenly spread over `range`, voxels outside of it aren't counted
+    std::vector<float> GetHistogram(int bin_count, const glm::vec2& range) const;
+
+    inline glm::vec2 GetRange() const { return glm::vec2(min, max); }
+    double GetMean() const;
+    double GetStandardDeviation() const;
+
+    size_t count = 0;
+    float min = 0.f;
+    float max = 0.f;
+    double mean = 0.0;
+    double m2 = 0.0;
+    VolumeDataType data_type = VolumeDataType::UINT8;
+    std::vector<uint64_t> bins;
+};
+
+#define VOLUME_STATISTICS_H
+#endif
@@ -6,6 +6,19 @@
 #include "Mesh.h"
 #include "Window.h"
 #include "Volume.h"
+#include "VolumeLoader.h"
+#include "VolumeHeader.h"
+#include "BrickedVolume.h"
+#include "CompressedVolume.h"
+#include "VolumeSequence.h"
+#include "SliceStack.h"
+#include "VolumeStatistics.h"
+#include "MinMaxGrid.h"
+#include "PreIntegration.h"
+#include "DynamicResolution.h"
+#include "CpuRayCaster.h"
+#include "ShearWarp.h"
+#include "RenderConstants.h"
 
 #include <stb_image/stb_image_write.h>
 #include <imgui.h>
@@ -16,26 +29,28 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
 #include <iostream>
 #include <vector>
 #include <filesystem>
+#include <thread>
+#include <atomic>
 #include <TFWidget/transfer_function_widget.h>
 
 /*
 * Todo:
 *   ->  There seems to be a CPU memory leak, not sure where
 * 
-*   ->  I must be leaking some memory by not deleting entry and exit points Texture2D, look into that
-* 
 *   ->  It would be nice to use std::exception for and get rid of all exit(1)'s in the code, it would give me more
 *       information about the error just occured
 *   
 *   ->  Logging to either VS Output window or a debug console powered by ImGui
 * 
-*   ->  Currently I can load only uint8 and uint16, add support for more
-* 
 *   ->  Loading of volume datasets aren't fool-proof, someone could easily mess up loading their data and get run-time
 *       error, maybe handle that case and show an error dialog
 * 
@@ -57,6 +72,226 @@ std::string volume_path = "../Resources/skull_256x256x256_uint8.raw";
 
 float sampling_rate = 2.f;
 
+// Note: Skips over the bricks of the volume the transfer function makes fully transparent, the image stays the same
+bool empty_space_skipping = true;
+
+// Note: Looks up whole segments between samples instead of single samples, which holds up at much lower sampling rates
+bool pre_integration = true;
+
+// Note: While the view, the transfer function or the volume is changing rays are cast at a fraction of the resolution
+// and the sampling rate, once it stops the image refines to full quality over the next frames
+bool progressive_refinement = true;
+float interaction_resolution_scale = 0.5f;
+
+// Note: Intersects the rays with the bounding box of the volume in the ray caster, instead of reading them from entry and
+// exit point textures rasterized from the cube beforehand. Saves both passes and works with the camera within the
+// volume, the textures are still there to compare against.
+bool analytic_ray_setup = true;
+
+// Note: Casts the rays with a compute shader in tiles of 8x8 pixels instead of the fragment shader, needs OpenGL 4.3
+bool compute_ray_caster = false;
+
+// Per-tile statistics of the last frame the compute ray caster cast
+struct TileStatistics
+{
+    int tile_count = 0;
+    int empty_tile_count = 0;
+    double mean_samples = 0.0;
+    unsigned int max_samples = 0;
+};
+
+// Note: Has to match the local size of Shaders/RayCaster.comp
+#define RAY_CASTER_TILE_SIZE 8
+
+// Note: Starts the rays of neighbouring pixels at different offsets within the sampling interval, trading the banding of
+// low sampling rates for noise
+bool jittered_sampling = true;
+
+// Note: Once the image is at full quality jittered frames keep being cast while nothing changes, and are averaged until
+// max_accumulated_frames of them are in
+bool temporal_accumulation = true;
+int max_accumulated_frames = 16;
+
+// Note: Renders the volume with shear-warp on the CPU instead of ray casting it on the GPU, for sessions without a usable
+// GPU (such as over remote desktop). The image is always at full quality. Views from within the volume, which shear-warp
+// can't render, and the steps of a sequence still go to the GPU.
+bool cpu_shear_warp = false;
+
+// Note: Picks the resolution of the frames cast while interacting to fit the ray casting pass into a frame time budget,
+// in place of interaction_resolution_scale
+bool dynamic_resolution = true;
+
+struct RenderQuality
+{
+    float resolution_scale;
+    float sampling_rate_scale;
+};
+
+// The levels progressive refinement steps through, one per frame, the last one is full quality
+#define REFINEMENT_LEVEL_COUNT 3
+RenderQuality GetRefinementQuality(int level)
+{
+    switch (level)
+    {
+        case 0: return { interaction_resolution_scale, 0.5f };
+        case 1: return { 1.f, 0.5f };
+        default: return { 1.f, 1.f };
+    }
+}
+
+// Everything the image of the volume depends on besides the transfer function, the rays are only cast again when some
+// of it changes. Otherwise the last image is reused and just the UI is drawn over it.
+struct RenderState
+{
+    glm::mat4 pvm;
+    glm::vec2 value_range;
+    float sampling_rate;
+    const Texture3D* volume_texture;
+    // Note: The texture slots of a sequence are reused, the step tells apart what is in them
+    int volume_step;
+    glm::ivec2 framebuffer_size;
+    bool empty_space_skipping;
+    bool pre_integration;
+    bool progressive_refinement;
+    float interaction_resolution_scale;
+    bool dynamic_resolution;
+    float frame_time_budget;
+    bool analytic_ray_setup;
+    bool compute_ray_caster;
+    bool jittered_sampling;
+    bool cpu_shear_warp;
+
+    bool operator==(const RenderState& other) const
+    {
+        return pvm == other.pvm && value_range == other.value_range && sampling_rate == other.sampling_rate && volume_texture == other.volume_texture
+            && volume_step == other.volume_step && framebuffer_size == other.framebuffer_size && empty_space_skipping == other.empty_space_skipping
+            && pre_integration == other.pre_integration && progressive_refinement == other.progressive_refinement
+            && interaction_resolution_scale == other.interaction_resolution_scale && dynamic_resolution == other.dynamic_resolution
+            && frame_time_budget == other.frame_time_budget && analytic_ray_setup == other.analytic_ray_setup
+            && compute_ray_caster == other.compute_ray_caster && jittered_sampling == other.jittered_sampling
+            && cpu_shear_warp == other.cpu_shear_warp;
+    }
+};
+
+// The offscreen targets the volume is rendered through, all of them the size of the framebuffer
+struct RenderTargets
+{
+    RenderTargets(int width, int height);
+    ~RenderTargets();
+
+    RenderTargets(const RenderTargets&) = delete;
+    RenderTargets& operator=(const RenderTargets&) = delete;
+
+    int width, height;
+
+    Texture2D entry_points;
+    Texture2D exit_points;
+    GLuint depth_rbo;
+    GLuint entry_exit_points_fbo;
+
+    // Note: Frames at a reduced resolution are cast into the lower left corner of this, then upsampled to the volume image
+    Texture2D low_resolution_image;
+    GLuint low_resolution_fbo;
+
+    // Note: The last image of the volume, copied to the window every frame before the UI is drawn over it
+    Texture2D volume_image;
+    GLuint volume_image_fbo;
+
+    // Note: The average of the frames accumulated so far, at a higher precision than the frames themselves
+    Texture2D accumulation_image;
+    GLuint accumulation_fbo;
+};
+
+RenderTargets::RenderTargets(int width, int height)
+    : width(width), height(height), entry_points(width, height, GL_RGBA16, GL_RGBA, GL_UNSIGNED_SHORT),
+    exit_points(width, height, GL_RGBA16, GL_RGBA, GL_UNSIGNED_SHORT), low_resolution_image(width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE),
+    volume_image(width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE), accumulation_image(width, height, GL_RGBA16F, GL_RGBA, GL_FLOAT)
+{
+    glGenFramebuffers(1, &entry_exit_points_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, entry_exit_points_fbo);
+
+    // Attach the attachements
+    entry_points.Bind();
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, entry_points.id, 0);
+
+    exit_points.Bind();
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, exit_points.id, 0);
+
+    glGenRenderbuffers(1, &depth_rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_rbo);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::ostringstream oss;
+        oss << "Entry and exit point framebuffer of " << width << "x" << height << " is incomplete" << std::endl;
+        OutputDebugStringA(oss.str().c_str());
+    }
+
+    glGenFramebuffers(1, &low_resolution_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, low_resolution_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, low_resolution_image.id, 0);
+
+    glGenFramebuffers(1, &volume_image_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, volume_image_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, volume_image.id, 0);
+
+    glGenFramebuffers(1, &accumulation_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, accumulation_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumulation_image.id, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+RenderTargets::~RenderTargets()
+{
+    glDeleteFramebuffers(1, &entry_exit_points_fbo);
+    glDeleteFramebuffers(1, &low_resolution_fbo);
+    glDeleteFramebuffers(1, &volume_image_fbo);
+    glDeleteFramebuffers(1, &accumulation_fbo);
+    glDeleteRenderbuffers(1, &depth_rbo);
+}
+
+// Note: ImGui takes a few frames to settle after an event (windows opening, hover states and the like), after that the
+// main loop sleeps until the next one unless there is still work going on
+#define IDLE_FRAME_COUNT 3
+
+// Note: Upper bound on the volume data handed to the driver each frame while a volume is streaming in
+int upload_budget_mb = 64;
+
+// Note: Only applies to volumes loaded after it is changed
+bool float32_to_float16 = false;
+
+// Note: Volumes which would take up more GPU memory than this are downsampled on load
+int texture_budget_mb = 2048;
+
+// Note: Builds the mip chain of the volume texture on load, which the ray casters sample while the samples are further
+// apart than the voxels (at low sampling rates), instead of skipping over voxels
+bool generate_mipmaps = false;
+
+// Region of interest, in voxels of the volume file, only read (and uploaded) if enabled in the File Details dialog
+bool load_region = false;
+glm::ivec3 region_begin(0);
+glm::ivec3 region_end(0);
+
+// Note: Queries the texture limits of the context, so only call it on the render thread
+VolumeLoadOptions GetLoadOptions()
+{
+    VolumeLoadOptions options;
+    options.float32_to_float16 = float32_to_float16;
+    options.memory_budget = (size_t)texture_budget_mb * 1024 * 1024;
+    options.generate_mipmaps = generate_mipmaps;
+    glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &options.max_texture_size);
+    if (load_region)
+    {
+        options.region_begin = region_begin;
+        options.region_end = region_end;
+    }
+    return options;
+}
+
 #if 0
 template <typename T>
 void Lerp(unsigned int x0, unsigned int x1, T* values)
@@ -172,58 +407,6 @@ ImVec4 GetListItemTextColor(bool is_directory, bool is_hidden)
     }
 }
 
-// Todo: Why not use unsigned char for "data"?
-GLuint ReadVolumeRAW(const char* path, const glm::ivec3& dimensions, const glm::vec3& spacing, unsigned int byte_count, char* data)
-{
-    // Read in the volume data
-    std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
-    if (file.is_open())
-    {
-        // Get size of the file
-        file.seekg(0, file.end);
-        size_t size = file.tellg();
-        file.seekg(0, file.beg);
-
-        data = new char[size];
-        file.read(data, size);
-
-        file.close();
-
-        assert(size == (size_t)dimensions.x * dimensions.y * dimensions.z * byte_count);
-
-        // Upload to the GPU
-        GLuint volume_texture;
-        glGenTextures(1, &volume_texture);
-        glBindTexture(GL_TEXTURE_3D, volume_texture);
-
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        // Upload it to the GPU, assuming that input volume data inherently doesn't have any row alignment
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-        if (byte_count == 1)
-            glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, dimensions.x, dimensions.y, dimensions.z, 0, GL_RED, GL_UNSIGNED_BYTE, data);
-        else
-            glTexImage3D(GL_TEXTURE_3D, 0, GL_R16, dimensions.x, dimensions.y, dimensions.z, 0, GL_RED, GL_UNSIGNED_SHORT, data);
-
-        glBindTexture(GL_TEXTURE_3D, 0);
-
-        return volume_texture;
-    }
-    else
-    {
-        std::ostringstream oss;
-        oss << "Unable to open file at path: " << path << std::endl;
-        OutputDebugStringA(oss.str().c_str());
-
-        return (GLuint)-1;
-    }
-}
-
 // Note: Model Matrix brings to World Space from Model Space
 glm::mat4 GetModelMatrix(const glm::ivec3& dimensions, const glm::vec3& spacing)
 {
@@ -356,7 +539,8 @@ void DrawFileList(float height)
 
             bool is_item_hidden = FILE_ATTRIBUTE_HIDDEN & GetFileAttributesW(filepath.wstring().c_str());
             bool is_item_displayable = (!is_item_hidden || (is_item_hidden && show_hidden_items))
-                && (entry.is_directory() || extension == ".raw" || extension == ".pvm");
+                && (entry.is_directory() || extension == ".raw" || extension == ".pvm" || IsVolumeHeaderFile(filepath.string())
+                || IsBrickedVolumeFile(filepath.string()) || IsGzipFile(filepath.string()) || IsSliceImageFile(filepath.string()));
             if (is_item_displayable)
             {
                 const std::string& path = filepath.filename().string();
@@ -372,6 +556,12 @@ void DrawFileList(float height)
                         {
                             current_dir.append("/" + path);
                         }
+                        else if (IsSliceImageFile(filepath.string()))
+                        {
+                            // Note: A single slice isn't much of a volume, open the whole stack it belongs to
+                            show_file_details_dialog = true;
+                            volume_path = std::filesystem::absolute(filepath).parent_path().string();
+                        }
                         else
                         {
                             show_file_details_dialog = true;
@@ -410,8 +600,248 @@ GLuint GetTFTexture(TransferFunctionWidget& tf_widget)
     return texture;
 }
 
+// Rebuilds the occupancy of the bricks of the volume from the opacities of the transfer function, (re)creating the
+// texture if the volume has a grid of a different size
+void UpdateOccupancyTexture(const Volume& volume, TransferFunctionWidget& tf_widget, std::unique_ptr<Texture3D>& texture)
+{
+    const std::vector<uint8_t> colormap = tf_widget.get_colormap();
+    std::vector<unsigned char> opacities(colormap.size() / 4);
+    for (size_t i = 0; i < opacities.size(); ++i)
+        opacities[i] = colormap[i * 4 + 3];
+
+    const MinMaxGrid& grid = *volume.min_max_grid;
+    std::vector<unsigned char> occupancy;
+    grid.GetOccupancy(opacities, volume.value_range, occupancy);
+
+    const glm::ivec3& dimensions = grid.dimensions;
+    if (!texture || texture->width != dimensions.x || texture->height != dimensions.y || texture->depth != dimensions.z)
+    {
+        // Note: Only ever read with texelFetch, so the filtering doesn't matter
+        texture = std::make_unique<Texture3D>(dimensions.x, dimensions.y, dimensions.z, GL_R8, GL_RED, GL_UNSIGNED_BYTE, occupancy.data());
+        return;
+    }
+
+    texture->Bind();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, dimensions.x, dimensions.y, dimensions.z, GL_RED, GL_UNSIGNED_BYTE, occupancy.data());
+    texture->Unbind();
+}
+
+// Connects stdout and stderr to the console the app was started from, if there is one. The app is a GUI program, so
+// Windows doesn't do that on its own and the command line modes would print nowhere.
+// Note: Streams which were redirected to a file or a pipe are connected already and left alone
+void AttachParentConsole()
+{
+    // Note: The CRT gives the streams of a GUI program without them a descriptor of -2
+    const bool stdout_connected = _fileno(stdout) >= 0;
+    const bool stderr_connected = _fileno(stderr) >= 0;
+    if ((stdout_connected && stderr_connected) || !AttachConsole(ATTACH_PARENT_PROCESS))
+        return;
+
+    FILE* stream;
+    if (!stdout_connected)
+        freopen_s(&stream, "CONOUT$", "w", stdout);
+    if (!stderr_connected)
+        freopen_s(&stream, "CONOUT$", "w", stderr);
+}
+
+// Prints a line of the command line modes to `stream` (stdout or stderr), and to the debugger like the rest of the log
+void PrintLine(FILE* stream, const std::string& line)
+{
+    OutputDebugStringA(line.c_str());
+    fputs(line.c_str(), stream);
+    fflush(stream);
+}
+
+// Reads a volume which describes itself with a header (NRRD or MetaImage, raw or compressed) into a CPU ray caster with
+// the default transfer function, nullptr if it can't be read
+std::unique_ptr<CpuRayCaster> CreateCpuRayCaster(const std::string& volume_file, VolumeDesc& desc)
+{
+    if (!IsVolumeHeaderFile(volume_file) || !ReadVolumeHeader(volume_file, desc))
+    {
+        std::ostringstream oss;
+        oss << "Unable to read the header of " << volume_file << std::endl;
+        PrintLine(stderr, oss.str());
+        return nullptr;
+    }
+
+    MappedFile file(desc.path.c_str());
+    const unsigned char* data = nullptr;
+    std::unique_ptr<CompressedVolume> compressed;
+    if (desc.encoding != VolumeEncoding::RAW)
+    {
+        compressed = std::make_unique<CompressedVolume>();
+        if (!file.IsOpen() || desc.data_offset < 0 || (size_t)desc.data_offset >= file.size
+            || !compressed->Open(file.data + desc.data_offset, file.size - (size_t)desc.data_offset, desc))
+            compressed = nullptr;
+    }
+    else if (file.IsOpen())
+    {
+        data = FindVoxelData(file, desc);
+    }
+
+    std::vector<unsigned char> voxels(desc.GetSize());
+    if ((!data && !compressed) || !ReadVoxelRegion(desc, data, nullptr, compressed.get(), nullptr, glm::ivec3(0), desc.dimensions, voxels.data()))
+    {
+        std::ostringstream oss;
+        oss << "Unable to read the voxels of " << volume_file << std::endl;
+        PrintLine(stderr, oss.str());
+        return nullptr;
+    }
+
+    // Note: The same value range a Volume picks
+    glm::vec2 value_range(0.f, 255.f);
+    if (desc.data_type == VolumeDataType::UINT16)
+        value_range = glm::vec2(0.f, 65535.f);
+    else if (desc.data_type != VolumeDataType::UINT8)
+        value_range = FindValueRange(voxels.data(), voxels.size() / desc.GetByteCount(), desc.data_type);
+
+    auto ray_caster = std::make_unique<CpuRayCaster>(desc.dimensions, voxels.data(), desc.data_type, value_range);
+
+    TransferFunctionWidget tf_widget;
+    ray_caster->SetTransferFunction(tf_widget.get_colormap());
+    ray_caster->sampling_rate = sampling_rate;
+    return ray_caster;
+}
+
+// Renders a volume with the CPU ray caster and writes the image, for "--cpu-render <volume> <image.png> [width height]"
+// on the command line. The volume is seen from where the camera starts out in the app, with the default transfer
+// function. Returns the exit code: 0 on success, 1 for bad arguments, 2 if the volume can't be read and 3 if the
+// image can't be written.
+//
+// Note: Neither a window nor OpenGL is needed for it, so it runs on machines without a GPU
+int RenderOnCpu(const std::string& arguments)
+{
+    std::istringstream iss(arguments);
+    std::string volume_file, image_file;
+    int image_width = 1280;
+    int image_height = 720;
+    iss >> std::quoted(volume_file) >> std::quoted(image_file);
+    if (!(iss >> image_width >> image_height))
+    {
+        image_width = 1280;
+        image_height = 720;
+    }
+
+    if (volume_file.empty() || image_file.empty() || image_width <= 0 || image_height <= 0)
+    {
+        PrintLine(stderr, "Usage: --cpu-render <volume header (.nrrd, .nhdr, .mha, .mhd)> <image.png> [width height]\n");
+        return 1;
+    }
+
+    VolumeDesc desc;
+    std::unique_ptr<CpuRayCaster> ray_caster = CreateCpuRayCaster(volume_file, desc);
+    if (!ray_caster)
+        return 2;
+
+    {
+        std::ostringstream oss;
+        oss << "Rendering on the CPU with " << GetInstructionSetName(ray_caster->instruction_set) << std::endl;
+        PrintLine(stdout, oss.str());
+    }
+
+    camera.SetViewportSize((float)image_width, (float)image_height);
+    const glm::mat4 pvm = camera.projection * camera.view * GetModelMatrix(desc.dimensions, desc.spacing);
+
+    std::vector<uint8_t> pixels;
+    ray_caster->Render(glm::inverse(pvm), image_width, image_height, pixels);
+
+    stbi_flip_vertically_on_write(0);
+    if (!stbi_write_png(image_file.c_str(), image_width, image_height, 4, pixels.data(), image_width * 4))
+    {
+        std::ostringstream oss;
+        oss << "Unable to write " << image_file << std::endl;
+        PrintLine(stderr, oss.str());
+        return 3;
+    }
+
+    return 0;
+}
+
+// Frames rendered per thread count by --cpu-benchmark, the fastest one counts
+#define CPU_BENCHMARK_FRAMES 3
+
+// Measures how the CPU ray caster scales with the number of threads, for "--cpu-benchmark <volume> [width height]" on
+// the command line. Renders the view of --cpu-render with pools of 1 to N threads (N being the number of cores) and
+// logs the best of CPU_BENCHMARK_FRAMES frames for each, along with the speedup over a single thread and the
+// efficiency (speedup / threads). Returns the exit code, the same ones as --cpu-render.
+int BenchmarkCpuThreads(const std::string& arguments)
+{
+    std::istringstream iss(arguments);
+    std::string volume_file;
+    int image_width = 1280;
+    int image_height = 720;
+    iss >> std::quoted(volume_file);
+    if (!(iss >> image_width >> image_height))
+    {
+        image_width = 1280;
+        image_height = 720;
+    }
+
+    if (volume_file.empty() || image_width <= 0 || image_height <= 0)
+    {
+        PrintLine(stderr, "Usage: --cpu-benchmark <volume header (.nrrd, .nhdr, .mha, .mhd)> [width height]\n");
+        return 1;
+    }
+
+    VolumeDesc desc;
+    std::unique_ptr<CpuRayCaster> ray_caster = CreateCpuRayCaster(volume_file, desc);
+    if (!ray_caster)
+        return 2;
+
+    camera.SetViewportSize((float)image_width, (float)image_height);
+    const glm::mat4 inverse_pvm = glm::inverse(camera.projection * camera.view * GetModelMatrix(desc.dimensions, desc.spacing));
+
+    {
+        std::ostringstream oss;
+        oss << "CPU ray caster, " << GetInstructionSetName(ray_caster->instruction_set) << ", " << image_width << "x"
+            << image_height << ":" << std::endl;
+        PrintLine(stdout, oss.str());
+    }
+
+    const unsigned int max_thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    double single_thread_time = 0.0;
+    std::vector<uint8_t> pixels;
+    for (unsigned int thread_count = 1; thread_count <= max_thread_count; ++thread_count)
+    {
+        ThreadPool thread_pool(thread_count);
+
+        double best_time = 0.0;
+        for (int frame = 0; frame < CPU_BENCHMARK_FRAMES; ++frame)
+        {
+            const auto start = std::chrono::high_resolution_clock::now();
+            ray_caster->Render(inverse_pvm, image_width, image_height, pixels, thread_pool);
+            const double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            best_time = frame == 0 ? time : std::min(best_time, time);
+        }
+
+        if (thread_count == 1)
+            single_thread_time = best_time;
+
+        const double speedup = single_thread_time / best_time;
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(2) << std::setw(3) << thread_count << " threads: " << std::setw(9) << best_time
+            << " ms, speedup " << speedup << ", efficiency " << std::setprecision(0) << speedup / thread_count * 100.0 << "%" << std::endl;
+        PrintLine(stdout, oss.str());
+    }
+
+    return 0;
+}
+
 int WINAPI WinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev_instance, _In_ LPSTR cmd_line, _In_ int show_code)
 {
+    const std::string arguments = cmd_line ? cmd_line : "";
+    if (arguments.rfind("--cpu-render", 0) == 0)
+    {
+        AttachParentConsole();
+        return RenderOnCpu(arguments.substr(12));
+    }
+    if (arguments.rfind("--cpu-benchmark", 0) == 0)
+    {
+        AttachParentConsole();
+        return BenchmarkCpuThreads(arguments.substr(15));
+    }
+
     int width = 1280;
     int height = 720;
     Window window(width, height, "Volume Renderer");
@@ -452,10 +882,19 @@ int WINAPI WinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev_instance, _I
     // Note: volume_path is temporarily global
     glm::ivec3 volume_dimensions(256);
     glm::vec3 volume_spacing(1.f);
-    unsigned int volume_byte_count = 1u;
-    char* volume_data = nullptr;
+    VolumeDataType volume_data_type = VolumeDataType::UINT8;
+
+    // Note: The volume is read in the background, until it is ready to be swapped in we keep rendering the
+    // previous one (or nothing at all, at startup)
+    VolumeLoader volume_loader;
+    std::unique_ptr<Volume> volume = nullptr;
+    volume_loader.Load({ volume_path, volume_dimensions, volume_spacing, volume_data_type }, GetLoadOptions());
 
-    GLuint volume_texture = ReadVolumeRAW(volume_path.c_str(), volume_dimensions, volume_spacing, volume_byte_count, volume_data);
+    // Note: A time series is opened by loading the selected step as a regular volume, the sequence takes over playback
+    // once it has been swapped in. Until the sequence has uploaded its first step, the volume itself is rendered.
+    bool load_as_sequence = false;
+    std::vector<std::string> sequence_paths;
+    std::unique_ptr<VolumeSequence> sequence = nullptr;
 
     glm::mat4 model = GetModelMatrix(volume_dimensions, volume_spacing);
     
@@ -509,49 +948,91 @@ int WINAPI WinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev_instance, _I
 
     TransferFunctionWidget tf_widget;
     GLuint transfer_function_texture = GetTFTexture(tf_widget);
+
+    // Note: The histogram behind the transfer function spans the value range, so it is rebinned whenever that changes
+    bool histogram_stale = true;
+    glm::vec2 histogram_range(0.f);
+
+    // Note: The occupancy of the bricks depends on both the transfer function and the value range
+    std::unique_ptr<Texture3D> occupancy_texture = nullptr;
+    bool occupancy_stale = true;
+    glm::vec2 occupancy_range(0.f);
+
+    // Note: Built in the background, the table in use stays until the new one is done
+    PreIntegrationTable preintegration_table;
+    bool preintegration_stale = true;
+    float preintegration_length = 0.f;
+
+    // Note: Built in the background from the volume the first time it is needed, and classified again in the background
+    // whenever the transfer function or the value range changes. The GPU renders until it is there, the renderer in use
+    // stays until a new classification is done (which is why it outlives the builder).
+    std::unique_ptr<ShearWarpRenderer> shear_warp = nullptr;
+    ShearWarpBuilder shear_warp_builder;
+    bool shear_warp_stale = true;
+    glm::vec2 shear_warp_range(0.f);
+    std::vector<uint8_t> shear_warp_pixels;
     
     Mesh cube(GetUnitCubeVertices(), 3, GetUnitCubeIndices());
     Mesh quad(GetNDCQuadVertices(), 2, GetNDCQuadIndices());
 
     Shader shader("../Source/Shaders/Shader.vs", "../Source/Shaders/Shader.fs");
 
-    shader.Bind();
-    shader.SetUniform3i("volume_dims", volume_dimensions[0], volume_dimensions[1], volume_dimensions[2]);
-    shader.SetUniform1i("volume", 2);
-    shader.SetUniform1i("transfer_function", 3);
+    // Note: Both ray casters share the uniforms (and the code) of Shaders/RayMarching.glsl
+    std::unique_ptr<Shader> compute_shader = GLAD_GL_VERSION_4_3 ? std::make_unique<Shader>("../Source/Shaders/RayCaster.comp") : nullptr;
+    for (Shader* ray_caster : { &shader, compute_shader.get() })
+    {
+        if (!ray_caster)
+            continue;
+
+        ray_caster->Bind();
+        ray_caster->SetUniform3i("volume_dims", volume_dimensions[0], volume_dimensions[1], volume_dimensions[2]);
+        ray_caster->SetUniform1i("entry_points_sampler", 0);
+        ray_caster->SetUniform1i("exit_points_sampler", 1);
+        ray_caster->SetUniform1i("volume", 2);
+        ray_caster->SetUniform1i("transfer_function", 3);
+        ray_caster->SetUniform1i("integer_volume", 4);
+        ray_caster->SetUniform1i("occupancy", 5);
+        ray_caster->SetUniform1i("preintegrated_transfer_function", 6);
+    }
+
+    // Note: Grown to the tile count of the image whenever it doesn't fit
+    GLuint tile_statistics_buffer = 0;
+    size_t tile_statistics_size = 0;
+    TileStatistics tile_statistics;
+    if (compute_shader)
+        glGenBuffers(1, &tile_statistics_buffer);
 
     Shader entry_exit_shader("../Source/Shaders/EntryExitPoints.vs", "../Source/Shaders/EntryExitPoints.fs");
 
-    Texture2D entry_points(width, height, GL_RGBA16, GL_RGBA, GL_UNSIGNED_SHORT);
-    Texture2D exit_points(width, height, GL_RGBA16, GL_RGBA, GL_UNSIGNED_SHORT);
+    Shader upsample_shader("../Source/Shaders/Shader.vs", "../Source/Shaders/Upsample.fs");
 
-    GLuint entry_exit_points_fbo;
-    glGenFramebuffers(1, &entry_exit_points_fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, entry_exit_points_fbo);
+    upsample_shader.Bind();
+    upsample_shader.SetUniform1i("low_resolution_image", 0);
+    upsample_shader.SetUniform1i("entry_points_sampler", 1);
+    upsample_shader.SetUniform1i("exit_points_sampler", 2);
 
-    // Attach the attachements
-    entry_points.Bind();
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, entry_points.id, 0);
+    Shader accumulate_shader("../Source/Shaders/Shader.vs", "../Source/Shaders/Accumulate.fs");
 
-    exit_points.Bind();
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, exit_points.id, 0);
+    accumulate_shader.Bind();
+    accumulate_shader.SetUniform1i("frame", 0);
 
-    GLuint depth_rbo;
-    glGenRenderbuffers(1, &depth_rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, depth_rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_rbo);
+    // Note: Recreated at the size of the framebuffer whenever the window is resized
+    std::unique_ptr<RenderTargets> render_targets = std::make_unique<RenderTargets>(width, height);
 
-    {
-        // Check Framebuffer status
-        bool framebuffer_status = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
-        if (framebuffer_status)
-        {
-            OutputDebugStringA("NOTE: Framebuffer is complete!\n");
-        }
-    }
+    DynamicResolution dynamic_resolution_controller;
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // The state the image and its refinement level were reached with, any change to it starts over from the coarsest
+    // level
+    RenderState last_render_state = {};
+    bool volume_image_stale = true;
+    int refinement_level = REFINEMENT_LEVEL_COUNT - 1;
+
+    // Frames averaged into the accumulation image since the image last changed, and the number of frames cast so far,
+    // which moves the jitter on
+    int accumulated_frames = 0;
+    int frame_index = 0;
+
+    int frames_until_idle = IDLE_FRAME_COUNT;
 
     glm::vec4 default_bg(0.5f, 0.5f, 0.5f, 1.f);
 
@@ -563,9 +1044,24 @@ int WINAPI WinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev_instance, _I
     bool save_as_png = false;
     std::string path_to_save_at = "";
 
+    // Note: Conversion maps the source file on its own, so it doesn't matter if the volume gets swapped out meanwhile
+    std::thread export_thread;
+    std::atomic<bool> exporting = false;
+
     while (!window.ShouldClose())
     {
-        window.PollEvents();
+        if (frames_until_idle > 0)
+        {
+            window.PollEvents();
+            --frames_until_idle;
+        }
+        else
+        {
+            window.WaitEvents();
+            frames_until_idle = IDLE_FRAME_COUNT;
+        }
+
+        bool transfer_function_changed = false;
 
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
@@ -590,6 +1086,20 @@ int WINAPI WinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev_instance, _I
                     show_save_file_dialog = true;
                 }
 
+                // Writes the current volume next to its source file, as a .bvol
+                if (ImGui::MenuItem("Export Bricked Volume", nullptr, false, volume && volume->data && !exporting))
+                {
+                    if (export_thread.joinable())
+                        export_thread.join();
+
+                    exporting = true;
+                    export_thread = std::thread([&exporting](VolumeDesc desc)
+                    {
+                        ConvertToBrickedVolume(desc, std::filesystem::path(desc.path).replace_extension(".bvol").string());
+                        exporting = false;
+                    }, volume->desc);
+                }
+
                 ImGui::EndMenu();
             }
 
@@ -615,6 +1125,21 @@ int WINAPI WinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev_instance, _I
                 ImGui::EndMenu();
             }
 
+            if (volume_loader.IsLoading())
+            {
+                ImGui::Text("Loading %s", std::filesystem::path(volume_loader.GetPath()).filename().string().c_str());
+                ImGui::ProgressBar(volume_loader.GetProgress(), ImVec2(200.f, 0.f));
+            }
+
+            if (exporting)
+                ImGui::Text("Exporting bricked volume..");
+
+            if (sequence)
+            {
+                const std::string& step_name = std::filesystem::path(sequence->GetPath(std::max(sequence->GetStep(), 0))).filename().string();
+                ImGui::Text("Step %d/%d (%s)", sequence->GetStep() + 1, sequence->GetStepCount(), step_name.c_str());
+            }
+
             ImGui::EndMainMenuBar();
         }
 
@@ -629,10 +1154,85 @@ int WINAPI WinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev_instance, _I
             }
 
             ImGui::SliderFloat("Sampling Rate", &sampling_rate, 1.f, 20.f);
+            ImGui::Checkbox("Empty Space Skipping", &empty_space_skipping);
+            ImGui::Checkbox("Pre-Integrated Transfer Function", &pre_integration);
+            ImGui::Checkbox("Analytic Ray Setup", &analytic_ray_setup);
+            if (compute_shader)
+            {
+                ImGui::Checkbox("Compute Ray Caster", &compute_ray_caster);
+                if (compute_ray_caster && tile_statistics.tile_count > 0)
+                {
+                    ImGui::Text("Tiles: %d, empty: %d (%.0f%%)", tile_statistics.tile_count, tile_statistics.empty_tile_count,
+                        100.0 * tile_statistics.empty_tile_count / tile_statistics.tile_count);
+                    ImGui::Text("Samples per tile: %.0f mean, %u max", tile_statistics.mean_samples, tile_statistics.max_samples);
+                }
+            }
+            ImGui::Checkbox("Shear-Warp on the CPU", &cpu_shear_warp);
+            ImGui::Checkbox("Jittered Sampling", &jittered_sampling);
+            if (jittered_sampling)
+            {
+                ImGui::Checkbox("Temporal Accumulation", &temporal_accumulation);
+                if (temporal_accumulation)
+                    ImGui::SliderInt("Accumulated Frames", &max_accumulated_frames, 2, 64);
+            }
+            ImGui::Checkbox("Progressive Refinement", &progressive_refinement);
+            ImGui::Checkbox("Dynamic Resolution", &dynamic_resolution);
+            if (dynamic_resolution)
+            {
+                ImGui::SliderFloat("Frame Time Budget (ms)", &dynamic_resolution_controller.budget_ms, 4.f, 66.f);
+                ImGui::Text("Last ray casting pass: %.2f ms", dynamic_resolution_controller.last_pass_ms);
+            }
+            else
+            {
+                ImGui::SliderFloat("Interaction Resolution", &interaction_resolution_scale, 0.25f, 1.f);
+            }
+            ImGui::SliderInt("Upload Budget (MB/frame)", &upload_budget_mb, 1, 512);
+            ImGui::Checkbox("Load float32 as float16", &float32_to_float16);
+            ImGui::SliderInt("Texture Budget (MB)", &texture_budget_mb, 64, 16384);
+
+            // Note: The transfer function spans the value range, anything outside of it is clamped
+            if (volume)
+            {
+                ImGui::Text("Data Type: %s, Data Range: [%g, %g]", GetDataTypeName(volume->desc.data_type), volume->data_range.x, volume->data_range.y);
+                ImGui::Text("Mean: %g, Std. Dev.: %g", volume->statistics->GetMean(), volume->statistics->GetStandardDeviation());
+                if (volume->downsample_factor > 1)
+                    ImGui::Text("Downsampled by %d to fit the texture budget", volume->downsample_factor);
+                const float speed = std::max(volume->data_range.y - volume->data_range.x, 1.f) / 1000.f;
+                ImGui::DragFloat2("Value Range", &volume->value_range[0], speed);
+                ImGui::SameLine();
+                if (ImGui::Button("Fit"))
+                    volume->value_range = volume->data_range;
+            }
+
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
             ImGui::End();
         }
 
+        if (sequence)
+        {
+            ImGui::Begin("Timeline");
+
+            if (ImGui::Button(sequence->playing ? "Pause" : "Play", ImVec2(60, 0)))
+                sequence->playing = !sequence->playing;
+
+            ImGui::SameLine();
+            bool reverse = sequence->direction < 0;
+            if (ImGui::Checkbox("Reverse", &reverse))
+                sequence->direction = reverse ? -1 : 1;
+
+            ImGui::SameLine();
+            ImGui::Checkbox("Loop", &sequence->loop);
+
+            int step = sequence->GetTargetStep();
+            if (ImGui::SliderInt("Step", &step, 0, sequence->GetStepCount() - 1))
+                sequence->Seek(step);
+
+            ImGui::SliderFloat("Steps/s", &sequence->steps_per_second, 1.f, 60.f);
+            ImGui::Text("Prefetched: %d step(s) ahead", sequence->GetPrefetchedStepCount());
+
+            ImGui::End();
+        }
+
         if (show_open_file_dialog)
         {
             ImVec2 file_browser_dimensions = PlaceFileBrowserWindow();
@@ -654,6 +1254,17 @@ int WINAPI WinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev_instance, _I
                 ImGui::SameLine();
                 ImGui::SetCursorPosX(file_browser_dimensions.x - 2.25f * button_size.x);
 
+                // Directories of slice images are opened as a whole
+                if (!current_dir.empty() && IsSliceStackDirectory(current_dir))
+                {
+                    ImGui::SameLine(550.f - button_size.x - 8.f);
+                    if (ImGui::Button("Open Folder", button_size))
+                    {
+                        show_file_details_dialog = true;
+                        volume_path = std::filesystem::absolute(current_dir).string();
+                    }
+                }
+
                 // Cancel Button
                 ImGui::SameLine(550.f);
                 if (ImGui::Button("Cancel", button_size))
@@ -667,7 +1278,8 @@ int WINAPI WinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev_instance, _I
                 {
                     ImVec2 center(ImGui::GetIO().DisplaySize.x * 0.5f, ImGui::GetIO().DisplaySize.y * 0.5f);
                     ImGui::SetNextWindowPos(center, ImGuiCond_Appearing, ImVec2(0.5f, 0.5f));
-                    ImGui::SetNextWindowSize(ImVec2(370, 180));
+                    // Note: Height 0 fits the dialog to whatever options it shows
+                    ImGui::SetNextWindowSize(ImVec2(370, 0));
 
                     ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(12, 8));
                     ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0, 12));
@@ -677,32 +1289,82 @@ int WINAPI WinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev_instance, _I
                     {
                         const char* datatype = "uint8";
 
-                        ImGui::TextWrapped("Loading <file-name>..\n"
-                            "Please provide following details for the dataset.");
+                        const std::string& file_name = std::filesystem::path(volume_path).filename().string();
+                        ImGui::TextWrapped("Loading %s..", file_name.c_str());
+
+                        // Note: Self-describing formats are read by the loader, there is nothing to ask for
+                        if (IsVolumeHeaderFile(volume_path) || IsBrickedVolumeFile(volume_path))
+                        {
+                            ImGui::TextWrapped("Dimensions, spacing and data type will be read from the header.");
+                        }
+                        else if (IsSliceStackDirectory(volume_path))
+                        {
+                            ImGui::TextWrapped("Dimensions and data type will be read from the slice images, one per Z slice.");
+                            ImGui::InputFloat3("Spacing", &volume_spacing[0]);
+                        }
+                        else
+                        {
+                            ImGui::TextWrapped("Please provide following details for the dataset.");
+
+                            // Note: In the order of VolumeDataType
+                            std::vector<const char*> datatypes = { "unsigned int 8 bit", "unsigned int 16 bit", "signed int 16 bit",
+                                "unsigned int 32 bit", "float 16 bit", "float 32 bit" };
+                            static int item_current = 0;
 
-                        std::vector<const char*> datatypes = { "unsigned int 8 bit", "unsigned int 16 bit" };
-                        static int item_current = 0;
+                            ImGui::Combo("Data Type", &item_current, datatypes.data(), datatypes.size());
+                            ImGui::InputInt3("Dimensions", &volume_dimensions[0]);
+                            ImGui::InputFloat3("Spacing", &volume_spacing[0]);
 
-                        ImGui::Combo("Data Type", &item_current, datatypes.data(), datatypes.size());
-                        ImGui::InputInt3("Dimensions", &volume_dimensions[0]);
-                        ImGui::InputFloat3("Spacing", &volume_spacing[0]);
+                            volume_data_type = (VolumeDataType)item_current;
+                        }
+
+                        // Note: Looking for the rest of the sequence hits the file system, so only do it once per file
+                        static std::string sequence_source;
+                        static std::vector<std::string> sequence_candidates;
+                        if (sequence_source != volume_path)
+                        {
+                            sequence_candidates = FindVolumeSequence(volume_path);
+                            sequence_source = volume_path;
+                        }
 
-                        volume_byte_count = item_current + 1;
+                        // Note: Region end is exclusive, leave an axis at 0 0 to load all of it
+                        ImGui::Checkbox("Region of Interest", &load_region);
+                        if (load_region)
+                        {
+                            ImGui::InputInt3("Region Begin", &region_begin[0]);
+                            ImGui::InputInt3("Region End", &region_end[0]);
+                        }
+
+                        ImGui::Checkbox("Generate Mipmaps", &generate_mipmaps);
+
+                        if (sequence_candidates.size() > 1)
+                        {
+                            ImGui::Checkbox("Time Series", &load_as_sequence);
+                            ImGui::SameLine();
+                            ImGui::Text("(%d steps)", (int)sequence_candidates.size());
+                        }
+
+                        sequence_paths = (load_as_sequence && sequence_candidates.size() > 1) ? sequence_candidates : std::vector<std::string>();
+
+                        // Note: The dialog stays open while the volume is being loaded, so the user can cancel it
+                        if (volume_loader.IsLoading())
+                            ImGui::ProgressBar(volume_loader.GetProgress());
 
                         ImGui::SetCursorPosX((ImGui::GetWindowContentRegionWidth() / 2.f) - 78.f);
-                        if (ImGui::Button("Open", ImVec2(72, 27)))
+                        if (ImGui::Button("Open", ImVec2(72, 27)) && !volume_loader.IsLoading())
                         {
                             // Send the data over to something responsible for loading the volume data
                             new_volume = true;
-                            show_file_details_dialog = false;
-                            show_open_file_dialog = false;
                         }
 
                         ImGui::SameLine(0.f);
                         ImGui::SetCursorPosX((ImGui::GetWindowContentRegionWidth() / 2.f) + 6.f);
                         if (ImGui::Button("Cancel", ImVec2(72, 27)))
                         {
-                            show_file_details_dialog = false;
+                            if (volume_loader.IsLoading())
+                                volume_loader.Cancel();
+                            else
+                                show_file_details_dialog = false;
 
                             // Todo: Make sure to set volume_path back according to the previous volume
                             // if the user indeed decides to cancel to loading of the new volume dataset, to avoid bugs
@@ -762,88 +1424,406 @@ int WINAPI WinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev_instance, _I
 
         if (show_tf_window)
         {
+            if (volume && (histogram_stale || histogram_range != volume->value_range))
+            {
+                // Log scaled, there is usually so much background that everything else would be flat
+                const int bin_count = (volume->desc.data_type == VolumeDataType::UINT8) ? 256 : 4096;
+                std::vector<float> histogram = volume->statistics->GetHistogram(bin_count, volume->value_range);
+                const float max_count = *std::max_element(histogram.begin(), histogram.end());
+                for (float& count : histogram)
+                    count = (max_count > 0.f) ? std::log1p(count) / std::log1p(max_count) : 0.f;
+
+                tf_widget.set_histogram(histogram);
+                histogram_range = volume->value_range;
+                histogram_stale = false;
+            }
+
             tf_widget.draw_ui();
 
             // Todo: You could use, glTexSubImage class of functions to replace the data in memory instead of
-            // deleting and reallocating it everytime.
-            glDeleteTextures(1, &transfer_function_texture);
+            // deleting and reallocating it
+            if (tf_widget.changed())
+            {
+                transfer_function_changed = true;
+                occupancy_stale = true;
+                preintegration_stale = true;
+                shear_warp_stale = true;
+                glDeleteTextures(1, &transfer_function_texture);
 
-            transfer_function_texture = GetTFTexture(tf_widget);
+                transfer_function_texture = GetTFTexture(tf_widget);
+            }
         }
 
         ImGui::Render();
 
-        // Load and upload the volume data if it has changed
+        // Kick off loading of the volume data if it has changed
         if (new_volume)
         {
-            glDeleteTextures(1, &volume_texture);
+            volume_loader.Load({ volume_path, volume_dimensions, volume_spacing, volume_data_type }, GetLoadOptions());
+            new_volume = false;
+        }
 
-            volume_texture = ReadVolumeRAW(volume_path.c_str(), volume_dimensions, volume_spacing, volume_byte_count, volume_data);
-            model = GetModelMatrix(volume_dimensions, volume_spacing);
+        volume_loader.Update((size_t)upload_budget_mb * 1024 * 1024);
+        if (sequence)
+            sequence->Update(ImGui::GetIO().DeltaTime, (size_t)upload_budget_mb * 1024 * 1024);
 
-            new_volume = false;
+        // Swap in the new volume once the loader is done with it
+        if (std::unique_ptr<StagedVolume> staged = volume_loader.TakeStaged())
+        {
+            // Note: A build still reading the previous volume has to stop before it goes away
+            shear_warp_builder.Cancel();
+            shear_warp = nullptr;
+
+            volume = std::make_unique<Volume>(std::move(staged));
+            histogram_stale = true;
+            occupancy_stale = true;
+            // Note: The proxy cube spans the region of interest only, so the entry and exit points are those of the region
+            model = GetModelMatrix(volume->GetRegionExtent(), volume->desc.spacing);
+
+            sequence = nullptr;
+            if (!sequence_paths.empty())
+            {
+                sequence = std::make_unique<VolumeSequence>(sequence_paths, VolumeDesc{ volume_path, volume_dimensions, volume_spacing, volume_data_type }, GetLoadOptions());
+                const auto selected = std::find(sequence_paths.begin(), sequence_paths.end(), std::filesystem::path(volume_path).string());
+                sequence->Seek(selected != sequence_paths.end() ? (int)(selected - sequence_paths.begin()) : 0);
+                sequence_paths.clear();
+            }
+
+            const glm::ivec3 texture_dimensions = volume->GetTextureDimensions();
+            for (Shader* ray_caster : { &shader, compute_shader.get() })
+            {
+                if (!ray_caster)
+                    continue;
+
+                ray_caster->Bind();
+                ray_caster->SetUniform3i("volume_dims", texture_dimensions.x, texture_dimensions.y, texture_dimensions.z);
+            }
+
+            show_file_details_dialog = false;
+            show_open_file_dialog = false;
+        }
+
+        if (volume && (occupancy_stale || occupancy_range != volume->value_range))
+        {
+            UpdateOccupancyTexture(*volume, tf_widget, occupancy_texture);
+            occupancy_range = volume->value_range;
+            occupancy_stale = false;
+            volume_image_stale = true;
+        }
+
+        if (volume && cpu_shear_warp && !shear_warp && !shear_warp_builder.IsBuilding())
+        {
+            // Note: Classified with the transfer function as it is now, changes made during the build make it stale again
+            shear_warp_builder.Build(*volume, tf_widget.get_colormap(), volume->value_range);
+            shear_warp_range = volume->value_range;
+            shear_warp_stale = false;
+        }
+
+        if (std::unique_ptr<ShearWarpRenderer> built = shear_warp_builder.TakeBuilt())
+        {
+            shear_warp = std::move(built);
+            volume_image_stale = true;
+        }
+        else if (shear_warp_builder.failed)
+        {
+            // Note: The builder logged why, the GPU takes over again
+            shear_warp_builder.failed = false;
+            cpu_shear_warp = false;
+        }
+
+        // Note: Changes made while a classification is running make it stale again, and it runs once more afterwards
+        if (shear_warp && cpu_shear_warp && !shear_warp_builder.IsBuilding() && (shear_warp_stale || shear_warp_range != volume->value_range))
+        {
+            shear_warp_builder.Reclassify(*shear_warp, tf_widget.get_colormap(), volume->value_range);
+            shear_warp_range = volume->value_range;
+            shear_warp_stale = false;
+        }
+
+        if (volume && pre_integration)
+        {
+            // Note: Built for rays along the mean dimension of the volume, the shader corrects the opacity of the rest
+            const glm::vec3 texture_dimensions = volume->GetTextureDimensions();
+            const float segment_length = REF_SAMPLING_INTERVAL / (sampling_rate * (texture_dimensions.x + texture_dimensions.y + texture_dimensions.z) / 3.f);
+            if (preintegration_stale || segment_length != preintegration_length)
+            {
+                preintegration_table.Rebuild(tf_widget.get_colormap(), segment_length);
+                preintegration_length = segment_length;
+                preintegration_stale = false;
+            }
         }
+        if (preintegration_table.Update())
+            volume_image_stale = true;
+
+        dynamic_resolution_controller.Update();
+
+        // Note: Float and integer samplers can't share a texture unit, the one not in use is left empty
+        const bool use_sequence_texture = sequence && sequence->GetTexture();
+        const Texture3D* volume_texture = use_sequence_texture ? sequence->GetTexture() : (volume ? volume->texture.get() : nullptr);
+        const bool is_integer_volume = volume && volume->IsIntegerTexture();
 
-        // Generate Entry and Exit point textures
-        glBindFramebuffer(GL_FRAMEBUFFER, entry_exit_points_fbo);
-        glEnable(GL_DEPTH_TEST);
-        glClearColor(0.f, 0.f, 0.f, 1.f);
+        // Note: A minimized window has a framebuffer of 0x0, the targets keep their size until it comes back
+        glm::ivec2 framebuffer_size;
+        glfwGetFramebufferSize(window.handle, &framebuffer_size.x, &framebuffer_size.y);
+        if (framebuffer_size.x > 0 && framebuffer_size.y > 0 && (framebuffer_size.x != width || framebuffer_size.y != height))
+        {
+            width = framebuffer_size.x;
+            height = framebuffer_size.y;
+            render_targets = std::make_unique<RenderTargets>(width, height);
+            camera.SetViewportSize((float)width, (float)height);
+        }
 
-        entry_exit_shader.Bind();
         glm::mat4 pvm = camera.projection * camera.view * model;
-        entry_exit_shader.SetUniformMatrix4fv("pvm", glm::value_ptr(pvm));
 
-        cube.BindVAO();
+        const RenderState render_state = { pvm, volume ? volume->value_range : glm::vec2(0.f), sampling_rate, volume_texture,
+            use_sequence_texture ? sequence->GetStep() : -1, framebuffer_size, empty_space_skipping, pre_integration, progressive_refinement,
+            interaction_resolution_scale, dynamic_resolution, dynamic_resolution_controller.budget_ms, analytic_ray_setup,
+            compute_ray_caster && compute_shader, jittered_sampling, cpu_shear_warp };
 
-        // Exit Points
-        glDrawBuffer(GL_COLOR_ATTACHMENT1);
-        glDepthFunc(GL_GREATER);
+        if (transfer_function_changed || !(render_state == last_render_state))
+        {
+            refinement_level = 0;
+            volume_image_stale = true;
+        }
+        else if (refinement_level < REFINEMENT_LEVEL_COUNT - 1)
+        {
+            ++refinement_level;
+            volume_image_stale = true;
+        }
+        last_render_state = render_state;
 
-        float old_depth;
-        glGetFloatv(GL_DEPTH_CLEAR_VALUE, &old_depth);
-        glClearDepth(0.f);
+        // Note: Screenshots are always taken at full quality, and shear-warp has no other
+        if ((!progressive_refinement || save_as_png || cpu_shear_warp) && refinement_level < REFINEMENT_LEVEL_COUNT - 1)
+        {
+            refinement_level = REFINEMENT_LEVEL_COUNT - 1;
+            volume_image_stale = true;
+        }
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glDrawElements(GL_TRIANGLE_STRIP, 14, GL_UNSIGNED_INT, 0);
+        // Note: Anything making the image stale up to here changed it, the frames accumulated so far no longer apply
+        const bool accumulating = jittered_sampling && temporal_accumulation && !cpu_shear_warp && refinement_level == REFINEMENT_LEVEL_COUNT - 1;
+        if (volume_image_stale)
+            accumulated_frames = 0;
+        else if (accumulating && accumulated_frames < max_accumulated_frames)
+            volume_image_stale = true;
 
-        // Entry Points
-        glDrawBuffer(GL_COLOR_ATTACHMENT0);
-        glDepthFunc(GL_LESS);
-        glClearDepth(old_depth);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (volume_image_stale && cpu_shear_warp && shear_warp && !use_sequence_texture
+            && shear_warp->Render(glm::inverse(pvm), width, height, shear_warp_pixels, true))
+        {
+            render_targets->volume_image.Bind();
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, shear_warp_pixels.data());
+            render_targets->volume_image.Unbind();
 
-        glDrawElements(GL_TRIANGLE_STRIP, 14, GL_UNSIGNED_INT, 0);
+            volume_image_stale = false;
+        }
 
-        // Second Pass
-        shader.Bind();
-        shader.SetUniformMatrix4fv("pvm", glm::value_ptr(pvm));
-        shader.SetUniform1i("entry_points_sampler", 0);
-        shader.SetUniform1i("exit_points_sampler", 1);
-        shader.SetUniform1f("sampling_rate", sampling_rate);
+        if (volume_image_stale)
+        {
+            glm::mat4 inverse_pvm = glm::inverse(pvm);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClearColor(0.5f, 0.5f, 0.5f, 1.f);
-        glDisable(GL_DEPTH_TEST);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            // Note: The analytic ray setup intersects the rays with the volume in the ray caster, there is nothing to
+            // rasterize beforehand
+            if (!analytic_ray_setup)
+            {
+                // Generate Entry and Exit point textures
+                glBindFramebuffer(GL_FRAMEBUFFER, render_targets->entry_exit_points_fbo);
+                glEnable(GL_DEPTH_TEST);
+                glClearColor(0.f, 0.f, 0.f, 1.f);
 
-        quad.BindVAO();
+                entry_exit_shader.Bind();
+                entry_exit_shader.SetUniformMatrix4fv("pvm", glm::value_ptr(pvm));
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, entry_points.id);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, exit_points.id);
+                cube.BindVAO();
 
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_3D, volume_texture);
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_1D, transfer_function_texture);
-        
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+                // Exit Points
+                glDrawBuffer(GL_COLOR_ATTACHMENT1);
+                glDepthFunc(GL_GREATER);
+
+                float old_depth;
+                glGetFloatv(GL_DEPTH_CLEAR_VALUE, &old_depth);
+                glClearDepth(0.f);
+
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glDrawElements(GL_TRIANGLE_STRIP, 14, GL_UNSIGNED_INT, 0);
+
+                // Entry Points
+                glDrawBuffer(GL_COLOR_ATTACHMENT0);
+                glDepthFunc(GL_LESS);
+                glClearDepth(old_depth);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                glDrawElements(GL_TRIANGLE_STRIP, 14, GL_UNSIGNED_INT, 0);
+            }
+
+            RenderQuality quality = GetRefinementQuality(refinement_level);
+            if (dynamic_resolution && refinement_level == 0)
+                quality.resolution_scale = dynamic_resolution_controller.GetResolutionScale(width * height, quality.sampling_rate_scale);
+
+            const int target_width = std::max((int)(width * quality.resolution_scale), 1);
+            const int target_height = std::max((int)(height * quality.resolution_scale), 1);
+            const bool low_resolution = target_width < width || target_height < height;
+
+            // Second Pass
+            Shader& ray_caster = (compute_ray_caster && compute_shader) ? *compute_shader : shader;
+            ray_caster.Bind();
+            ray_caster.SetUniform1i("analytic_rays", analytic_ray_setup);
+            ray_caster.SetUniformMatrix4fv("inverse_pvm", glm::value_ptr(inverse_pvm));
+            ray_caster.SetUniform1f("sampling_rate", sampling_rate * quality.sampling_rate_scale);
+
+            // Note: Samples further apart than the voxels read the mip level whose voxels are as far apart, if there is one
+            const bool has_mip_levels = volume_texture && volume_texture->level_count > 1 && !is_integer_volume;
+            const float volume_lod = has_mip_levels ? std::max(-std::log2(sampling_rate * quality.sampling_rate_scale), 0.f) : 0.f;
+            ray_caster.SetUniform1f("volume_lod", volume_lod);
+            ray_caster.SetUniform2f("viewport_size", (float)target_width, (float)target_height);
+            if (volume)
+            {
+                const glm::vec2 value_remap = volume->GetValueRemap();
+                ray_caster.SetUniform1f("value_scale", value_remap.x);
+                ray_caster.SetUniform1f("value_bias", value_remap.y);
+                ray_caster.SetUniform1i("is_integer_volume", volume->IsIntegerTexture());
+                ray_caster.SetUniform1i("brick_size", volume->min_max_grid->brick_size);
+            }
+
+            // Note: The grid is that of the volume, the steps of a sequence don't have one. Its bricks only take in the
+            // voxels one past their faces, which the coarser mip levels reach well beyond, so it's only used on level 0.
+            ray_caster.SetUniform1i("skip_empty_space", empty_space_skipping && volume && !use_sequence_texture && volume_lod == 0.f);
+            ray_caster.SetUniform1i("pre_integrated", pre_integration && preintegration_table.IsReady());
+            ray_caster.SetUniform1f("preintegration_length", preintegration_table.uploaded_segment_length);
+            ray_caster.SetUniform1i("jitter_rays", jittered_sampling);
+            ray_caster.SetUniform1i("frame_index", frame_index++);
+
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, render_targets->entry_points.id);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, render_targets->exit_points.id);
+
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_3D, (volume_texture && !is_integer_volume) ? volume_texture->id : 0);
+            glActiveTexture(GL_TEXTURE4);
+            glBindTexture(GL_TEXTURE_3D, (volume_texture && is_integer_volume) ? volume_texture->id : 0);
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_1D, transfer_function_texture);
+            glActiveTexture(GL_TEXTURE5);
+            glBindTexture(GL_TEXTURE_3D, occupancy_texture ? occupancy_texture->id : 0);
+            glActiveTexture(GL_TEXTURE6);
+            glBindTexture(GL_TEXTURE_2D, preintegration_table.texture);
+
+            // Note: The later passes draw the quad as well
+            quad.BindVAO();
+
+            const Texture2D& target = low_resolution ? render_targets->low_resolution_image : render_targets->volume_image;
+            if (&ray_caster == compute_shader.get())
+            {
+                const glm::ivec2 tile_counts = (glm::ivec2(target_width, target_height) + RAY_CASTER_TILE_SIZE - 1) / RAY_CASTER_TILE_SIZE;
+                const size_t tile_count = (size_t)tile_counts.x * tile_counts.y;
+
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, tile_statistics_buffer);
+                if (tile_statistics_size < tile_count)
+                {
+                    glBufferData(GL_SHADER_STORAGE_BUFFER, tile_count * sizeof(GLuint), nullptr, GL_DYNAMIC_READ);
+                    tile_statistics_size = tile_count;
+                }
+                glBindImageTexture(0, target.id, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+                dynamic_resolution_controller.BeginPass();
+                glDispatchCompute(tile_counts.x, tile_counts.y, 1);
+                dynamic_resolution_controller.EndPass(target_width * target_height, quality.sampling_rate_scale);
+
+                glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+                // Note: Reading them back waits for the pass to finish, so it is only done while they are on screen
+                if (show_settings_window)
+                {
+                    std::vector<GLuint> tile_samples(tile_count);
+                    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, tile_count * sizeof(GLuint), tile_samples.data());
+
+                    tile_statistics = TileStatistics();
+                    tile_statistics.tile_count = (int)tile_count;
+                    for (GLuint samples : tile_samples)
+                    {
+                        tile_statistics.empty_tile_count += (samples == 0);
+                        tile_statistics.mean_samples += samples;
+                        tile_statistics.max_samples = std::max(tile_statistics.max_samples, samples);
+                    }
+                    tile_statistics.mean_samples /= (double)tile_count;
+                }
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            }
+            else
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, low_resolution ? render_targets->low_resolution_fbo : render_targets->volume_image_fbo);
+                glViewport(0, 0, target_width, target_height);
+                glClearColor(0.5f, 0.5f, 0.5f, 1.f);
+                glDisable(GL_DEPTH_TEST);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                shader.SetUniformMatrix4fv("pvm", glm::value_ptr(pvm));
+
+                dynamic_resolution_controller.BeginPass();
+                glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+                dynamic_resolution_controller.EndPass(target_width * target_height, quality.sampling_rate_scale);
+            }
+
+            glViewport(0, 0, width, height);
+
+            if (low_resolution)
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, render_targets->volume_image_fbo);
+
+                upsample_shader.Bind();
+                upsample_shader.SetUniform2f("low_resolution_size", (float)target_width, (float)target_height);
+                upsample_shader.SetUniform2f("viewport_size", (float)width, (float)height);
+                upsample_shader.SetUniform1i("analytic_rays", analytic_ray_setup);
+                upsample_shader.SetUniformMatrix4fv("inverse_pvm", glm::value_ptr(inverse_pvm));
+
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, render_targets->low_resolution_image.id);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, render_targets->entry_points.id);
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_2D, render_targets->exit_points.id);
+
+                glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+            }
+
+            // Note: Frames at full quality are always at full resolution, the average is copied back to the volume image
+            if (accumulating)
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, render_targets->accumulation_fbo);
+
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
+                glBlendColor(0.f, 0.f, 0.f, 1.f / (float)(accumulated_frames + 1));
+
+                accumulate_shader.Bind();
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, render_targets->volume_image.id);
+
+                glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+                glDisable(GL_BLEND);
+                ++accumulated_frames;
+
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, render_targets->accumulation_fbo);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, render_targets->volume_image_fbo);
+                glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            }
+
+            volume_image_stale = false;
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glClearColor(0.5f, 0.5f, 0.5f, 1.f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, render_targets->volume_image_fbo);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
         if (save_as_png)
         {
+            // Note: Read from the image of the volume, the window has the UI on top of it by the time it is shown
+            glBindFramebuffer(GL_FRAMEBUFFER, render_targets->volume_image_fbo);
 #ifdef _DEBUG
-            // Check the default framebuffer data type because it will affect PNG writing
+            // Check the framebuffer data type because it will affect PNG writing
             GLint value = 0;
 
             glGetFramebufferParameteriv(GL_FRAMEBUFFER, GL_IMPLEMENTATION_COLOR_READ_FORMAT, &value);
@@ -853,8 +1833,11 @@ int WINAPI WinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev_instance, _I
             assert(value == GL_UNSIGNED_BYTE);
 
 #endif
-            unsigned char* pixels = (unsigned char*)malloc(1280 * 720 * 3);
+            // Note: Rows of RGB pixels aren't a multiple of 4 bytes for every width
+            unsigned char* pixels = (unsigned char*)malloc((size_t)width * height * 3);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
             glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
             // Todo: If path_to_save_at doesn't end with a .png, append!
             assert(path_to_save_at.length() != 0);
@@ -875,8 +1858,19 @@ int WINAPI WinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev_instance, _I
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
         window.SwapBuffers();
+
+        // Note: Background work reports back through the main loop, so it keeps spinning until all of it is done
+        const bool busy = volume_loader.IsLoading() || exporting || preintegration_table.IsBuilding() || shear_warp_builder.IsBuilding()
+            || refinement_level < REFINEMENT_LEVEL_COUNT - 1
+            || (accumulating && accumulated_frames < max_accumulated_frames)
+            || (sequence && (sequence->playing || sequence->GetStep() != sequence->GetTargetStep()));
+        if (busy)
+            frames_until_idle = IDLE_FRAME_COUNT;
     }
 
+    if (export_thread.joinable())
+        export_thread.join();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
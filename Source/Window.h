@@ -14,6 +14,7 @@ struct Window
 
     inline bool ShouldClose() const { return glfwWindowShouldClose(handle); }
     inline void PollEvents() const { glfwPollEvents(); }
+    inline void WaitEvents() const { glfwWaitEvents(); }
     inline void SwapBuffers() const { glfwSwapBuffers(handle); }
 
     GLFWwindow* handle;